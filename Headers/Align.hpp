@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+// rounds up to a multiple of alignment, which doesn't have to be a power of two. VkDeviceSize is a uint64_t as well
+constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
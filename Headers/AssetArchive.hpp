@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one file holding every asset: a header, the index sorted by name, the names, then each blob aligned to ASSET_ARCHIVE_ALIGNMENT.
+// names are generic paths relative to where the packer ran, like "Shaders/shader.vert.spv"
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_ALIGNMENT 64
+
+enum class AssetCompression : uint32_t
+{
+    None,
+    // lz77 with the lz4 block layout, tokens of literal and match lengths followed by 16 bit offsets
+    LZ
+};
+
+struct AssetArchiveHeader
+{
+    char magic[4] = {'V', 'P', 'A', 'K'};
+    uint32_t version = ASSET_ARCHIVE_VERSION;
+    uint32_t entryCount = 0;
+    uint32_t namesSize = 0;
+    uint64_t indexOffset = 0;
+    uint64_t namesOffset = 0;
+};
+
+struct AssetArchiveEntry
+{
+    uint64_t offset = 0;
+    // bytes in the archive and after decompression, equal for uncompressed entries
+    uint64_t storedSize = 0;
+    uint64_t size = 0;
+    // fnv-1a of the uncompressed bytes
+    uint64_t hash = 0;
+    uint32_t nameOffset = 0;
+    uint32_t nameLength = 0;
+    AssetCompression compression = AssetCompression::None;
+    uint32_t padding = 0;
+};
+
+struct AssetArchiveSource
+{
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+uint64_t HashAssetData(std::span<const uint8_t> data);
+
+// empty when the data doesn't shrink
+std::vector<uint8_t> CompressAssetData(std::span<const uint8_t> data);
+// false when the stream is broken or doesn't fill destination exactly
+bool DecompressAssetData(std::span<const uint8_t> compressed, std::span<uint8_t> destination);
+
+// sorts the sources by name, compressed entries are only kept when they save at least an eighth
+bool WriteAssetArchive(const std::string& path, std::vector<AssetArchiveSource>& sources, bool compress);
+
+// read only mapping of an archive, every lookup is a binary search over the mapped index and allocates nothing
+class AssetArchive
+{
+public:
+    // validates the header and every entry's bounds, so lookups can trust them afterwards
+    bool Open(const char* path);
+    void Close();
+    bool IsOpen() const { return mData != nullptr; }
+    const std::string& GetPath() const { return mPath; }
+
+    // null when the name isn't packed
+    const AssetArchiveEntry* Find(std::string_view name) const;
+    std::span<const AssetArchiveEntry> GetEntries() const { return mEntries; }
+    std::string_view GetName(const AssetArchiveEntry& entry) const;
+
+    // zero copy view into the mapping, valid until Close. empty for missing and compressed entries, those go through Read
+    std::span<const uint8_t> GetData(std::string_view name) const;
+    std::span<const uint8_t> GetData(const AssetArchiveEntry& entry) const;
+    // copies or decompresses into destination, which must be entry.size bytes
+    bool Read(const AssetArchiveEntry& entry, std::span<uint8_t> destination) const;
+
+private:
+    std::string mPath;
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    std::span<const AssetArchiveEntry> mEntries;
+    const char* mNames = nullptr;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#endif
+};
@@ -2,6 +2,23 @@
 #include "CommonIncludes.hpp"
 #include "Macros.hpp"
 
+enum class QualityTier
+{
+    Low,
+    Medium,
+    High,
+    Ultra
+};
+
+struct GameOptions
+{
+    bool headless = false;
+    QualityTier quality = QualityTier::High;
+    uint32_t frameCount = 1000;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+};
+
 class Game
 {
 public:
@@ -9,9 +26,10 @@ public:
     void Terminate();
     void Run();
 
-    Game();
+    Game(const GameOptions& options = {});
     ~Game();
 private:
+    GameOptions mOptions;
     Window mWindow;
     vkn::VulkanContext mVulkanContext;
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+// fixed set of worker threads for cpu side work that doesn't touch the device, jobs run in submission order.
+// a pool that was never created runs every job inline on the submitting thread.
+// jobs must not wait on other jobs, with every worker blocked nothing would be left to run them
+class JobPool
+{
+public:
+    // 0 takes every hardware thread but the calling one
+    void Create(uint32_t workerCount = 0);
+    // runs whatever is still queued before the workers exit, so no future is left without a value
+    void Destroy();
+
+    template<typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function&& function)
+    {
+        using Result = std::invoke_result_t<Function>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    uint32_t GetWorkerCount() const { return mWorkers.size(); }
+
+private:
+    void push(std::function<void()>&& job);
+    void workerLoop();
+
+    std::vector<std::thread> mWorkers;
+    std::deque<std::function<void()>> mQueue;
+    std::mutex mMutex;
+    std::condition_variable mQueueCondition;
+    bool mStopping = false;
+};
@@ -3,4 +3,14 @@
 
 #define ENABLE_VULKAN_VALIDATION 1
 
+#define ENABLE_PROFILER 1
+
+#define PIPELINE_CACHE_FILENAME "pipeline.cache"
+#define GPU_TRACE_FILENAME "gpu_trace.json"
+#define CPU_TRACE_FILENAME "cpu_trace.json"
+#define HEADLESS_TIMINGS_FILENAME "headless_timings.csv"
+#define ASSET_ARCHIVE_FILENAME "Assets.pak"
+
+#define MAX_FRAMES_IN_FLIGHT 2
+
 #define VK_CHECK(function) if(function != VK_SUCCESS) { std::println("vulkan function failed: {}", #function); }
\ No newline at end of file
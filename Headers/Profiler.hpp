@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "Macros.hpp"
+
+#if ENABLE_PROFILER
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_FRAME() Profiler::MarkFrame()
+#define PROFILE_COUNTER(name, value) Profiler::RecordCounter(name, static_cast<double>(value))
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_FRAME()
+#define PROFILE_COUNTER(name, value)
+#define PROFILE_THREAD(name)
+
+#endif
+
+enum class ProfileEventType : uint8_t
+{
+    Zone,
+    Counter,
+    Frame
+};
+
+struct ProfileEvent
+{
+    const char* name = nullptr;
+    double startUs = 0.0;
+    double value = 0.0;
+    ProfileEventType type = ProfileEventType::Zone;
+};
+
+// every thread appends to its own ring of events, only the first event of a thread takes a lock,
+// names must outlive the profiler since only the pointer is stored
+class Profiler
+{
+public:
+    static double NowUs();
+
+    static void RecordZone(const char* name, double startUs, double durationUs);
+    static void RecordCounter(const char* name, double value);
+    static void MarkFrame();
+    static void SetThreadName(const char* name);
+
+    static void WriteChromeTrace(const char* filename);
+};
+
+class ProfileZone
+{
+public:
+    ProfileZone(const char* name) : mName(name), mStartUs(Profiler::NowUs()) {}
+    ~ProfileZone() { Profiler::RecordZone(mName, mStartUs, Profiler::NowUs() - mStartUs); }
+
+private:
+    const char* mName;
+    double mStartUs;
+};
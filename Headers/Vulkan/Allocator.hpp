@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+namespace vkn
+{
+    struct Allocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeIndex = UINT32_MAX;
+        void* map = nullptr;
+
+        // range handed back to the block free list, UINT32_MAX block means a dedicated allocation
+        uint32_t blockIndex = UINT32_MAX;
+        VkDeviceSize rangeOffset = 0;
+        VkDeviceSize rangeSize = 0;
+    };
+
+    struct AllocatorStats
+    {
+        VkDeviceSize liveBytes = 0;
+        VkDeviceSize reservedBytes = 0;
+        VkDeviceSize freeBytes = 0;
+        VkDeviceSize largestFreeRange = 0;
+        uint32_t allocationCount = 0;
+        uint32_t blockCount = 0;
+        uint32_t dedicatedCount = 0;
+        float fragmentation = 0.f;
+    };
+
+    class Allocator
+    {
+    public:
+        void Create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+        void Destroy();
+
+        // preferred flags are tried on top of properties first, lazily allocated memory always gets a dedicated allocation
+        Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, VkMemoryPropertyFlags preferred = 0);
+        void Free(Allocation& allocation);
+
+        AllocatorStats GetStats() const;
+        void PrintStats() const;
+
+        VkDevice GetDevice() const { return mDevice; }
+        VkPhysicalDevice GetPhysicalDevice() const { return mPhysicalDevice; }
+
+    private:
+        struct Block
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            VkDeviceSize used = 0;
+            uint32_t memoryTypeIndex = UINT32_MAX;
+            uint32_t allocationCount = 0;
+            bool linear = true;
+            void* map = nullptr;
+            std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+        };
+
+        VkDeviceSize getSizeClass(VkDeviceSize size) const;
+        VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+        bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& rangeOffset, VkDeviceSize& rangeSize, VkDeviceSize& offset);
+        uint32_t createBlock(uint32_t memoryTypeIndex, bool linear);
+        void releaseBlock(uint32_t blockIndex);
+        VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** map);
+
+        VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE;
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties mMemoryProperties = {};
+        VkDeviceSize mBlockSize = 0;
+        VkDeviceSize mBufferImageGranularity = 1;
+
+        std::vector<Block> mBlocks;
+        VkDeviceSize mLiveBytes = 0;
+        VkDeviceSize mDedicatedBytes = 0;
+        uint32_t mAllocationCount = 0;
+        uint32_t mDedicatedCount = 0;
+        mutable std::mutex mMutex;
+    };
+}
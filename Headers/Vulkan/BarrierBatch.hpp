@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vkn
+{
+    // collects barriers and records them with a single vkCmdPipelineBarrier2,
+    // or a single vkCmdPipelineBarrier when synchronization2 is not enabled
+    class BarrierBatch
+    {
+    public:
+        void ImageBarrier(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+            uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+        // only the given mips and layers, for images whose parts are uploaded or written separately
+        void ImageBarrier(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+            uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+        void BufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+            VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+            uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+        void GlobalBarrier(VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+
+        void Append(const BarrierBatch& other);
+        void Record(VkCommandBuffer commandBuffer, bool synchronization2);
+        void Clear();
+
+        bool IsEmpty() const { return mImageBarriers.empty() && mBufferBarriers.empty() && mMemoryBarriers.empty(); }
+        VkPipelineStageFlags2 GetDstStageMask() const { return mDstStageMask; }
+
+    private:
+        std::vector<VkImageMemoryBarrier2> mImageBarriers;
+        std::vector<VkBufferMemoryBarrier2> mBufferBarriers;
+        std::vector<VkMemoryBarrier2> mMemoryBarriers;
+        VkPipelineStageFlags2 mSrcStageMask = 0;
+        VkPipelineStageFlags2 mDstStageMask = 0;
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vulkan/vulkan.h>
+
+namespace vkn
+{
+    struct CommandAllocatorStats
+    {
+        uint64_t allocations = 0;
+        uint64_t reuses = 0;
+        uint64_t poolResets = 0;
+    };
+
+    // hands out command buffers from one pool per recording thread and frame in flight,
+    // BeginFrame must be called from the frame thread while no other thread is recording
+    class CommandAllocator
+    {
+    public:
+        void Create(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount);
+        void Destroy();
+
+        void BeginFrame(uint32_t frameIndex, VkFence fence = VK_NULL_HANDLE);
+        VkCommandBuffer Allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        CommandAllocatorStats GetStats() const;
+
+    private:
+        struct Pool
+        {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> primary;
+            std::vector<VkCommandBuffer> secondary;
+            uint32_t usedPrimary = 0;
+            uint32_t usedSecondary = 0;
+        };
+
+        struct ThreadPools
+        {
+            std::vector<Pool> frames;
+        };
+
+        ThreadPools& getThreadPools();
+
+        VkDevice mDevice = VK_NULL_HANDLE;
+        uint32_t mQueueFamilyIndex = 0;
+        uint32_t mFrameCount = 0;
+        uint32_t mFrameIndex = 0;
+        uint64_t mId = 0;
+
+        std::vector<std::unique_ptr<ThreadPools>> mThreads;
+        std::mutex mMutex;
+
+        std::atomic<uint64_t> mAllocations = 0;
+        std::atomic<uint64_t> mReuses = 0;
+        std::atomic<uint64_t> mPoolResets = 0;
+    };
+}
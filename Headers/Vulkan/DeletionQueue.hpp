@@ -0,0 +1,35 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+namespace vkn
+{
+    // defers destruction until every frame that could still reference a resource has retired,
+    // BeginFrame must be called right after waiting on the oldest frame in flight
+    class DeletionQueue
+    {
+    public:
+        void Create(uint32_t frameLatency);
+        void Destroy();
+
+        void BeginFrame();
+        void Push(std::function<void()>&& deleter);
+
+        uint64_t GetFrame() const { return mFrame; }
+
+    private:
+        struct Entry
+        {
+            uint64_t frame = 0;
+            std::function<void()> deleter;
+        };
+
+        uint32_t mFrameLatency = 0;
+        uint64_t mFrame = 0;
+
+        std::deque<Entry> mEntries;
+        std::mutex mMutex;
+    };
+}
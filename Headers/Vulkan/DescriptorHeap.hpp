@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <Vulkan/Types.hpp>
+
+namespace vkn
+{
+    // global update-after-bind table of sampled images, a small table of sampled image arrays and a small sampler table,
+    // shaders pick entries by index so the whole heap is bound once per frame
+    class DescriptorHeap
+    {
+    public:
+        void Create(const VulkanContext& context, uint32_t maxTextures = 4096, uint32_t maxSamplers = 16, uint32_t maxTextureArrays = 16);
+        void Destroy();
+
+        uint32_t RegisterTexture(VkImageView imageView);
+        void ReleaseTexture(uint32_t index);
+        // the view must be a 2d array view, indexes are separate from the plain textures
+        uint32_t RegisterTextureArray(VkImageView imageView);
+        void ReleaseTextureArray(uint32_t index);
+        uint32_t RegisterSampler(VkSampler sampler);
+
+        void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const;
+
+        VkDescriptorSetLayout GetSetLayout() const { return mSetLayout; }
+        uint32_t GetDefaultSampler() const { return 0; }
+        uint32_t GetTextureCount() const { return mTextureCount - mFreeTextures.size(); }
+
+    private:
+        uint32_t allocateIndex(std::vector<uint32_t>& freeIndices, uint32_t& count, uint32_t max, const char* name);
+        void writeImage(uint32_t binding, uint32_t index, VkImageView imageView);
+
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkDescriptorSetLayout mSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool mPool = VK_NULL_HANDLE;
+        VkDescriptorSet mSet = VK_NULL_HANDLE;
+
+        uint32_t mMaxTextures = 0;
+        uint32_t mMaxSamplers = 0;
+        uint32_t mMaxTextureArrays = 0;
+        uint32_t mTextureCount = 0;
+        uint32_t mTextureArrayCount = 0;
+        std::vector<uint32_t> mFreeTextures;
+        std::vector<uint32_t> mFreeTextureArrays;
+        std::vector<VkSampler> mSamplers;
+        VkSampler mDefaultSampler = VK_NULL_HANDLE;
+
+        std::mutex mMutex;
+    };
+}
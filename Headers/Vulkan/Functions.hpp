@@ -2,41 +2,71 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <span>
 #include <print>
 #include "Types.hpp"
+#include "BarrierBatch.hpp"
 
 namespace vkn
 {
     
-    VkSampleCountFlagBits GetSampleCount();
+    // highest count supported for both color and depth that doesn't exceed requested
+    VkSampleCountFlagBits GetSampleCount(VkPhysicalDevice physicalDevice, VkSampleCountFlagBits requested = VK_SAMPLE_COUNT_8_BIT);
     VkFormat GetDisplayFormat();
-    VkInstance CreateInstance();
+    VkInstance CreateInstance(bool enableSurface = true);
     VkPhysicalDevice GetPhysicalDevice(VkInstance instance);
     VkSurfaceKHR CreateSurface(VkInstance instance, GLFWwindow* window);
     QueueIndices GetQueueIndices(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
-    VkDevice CreateDevice(VkPhysicalDevice physicalDevice, const QueueIndices& queueIndices);
+    DeviceFeatures GetDeviceFeatures(VkPhysicalDevice physicalDevice);
+    VkDevice CreateDevice(VkPhysicalDevice physicalDevice, const QueueIndices& queueIndices, const DeviceFeatures& features);
     Queues GetDeviceQueue(VkDevice device, const QueueIndices& queueIndices);
-    VkRenderPass CreateRenderPass(VkDevice device);
-    Swapchain CreateSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkRenderPass renderPass, GLFWwindow* window);
+    VkRenderPass CreateRenderPass(VkDevice device, VkSampleCountFlagBits samples, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, bool keepDepth = false);
+    // single sample depth only pass whose result is read by compute or fragment shaders afterwards
+    VkRenderPass CreateDepthRenderPass(VkDevice device, VkFormat format, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    VkRenderPass GetRenderPass(VulkanContext& context, const RenderQuality& quality, VkImageLayout finalLayout);
+    // passing the previous swapchain hands its attachments over when the extent is unchanged, its remaining resources stay for DestroySwapchain
+    Swapchain CreateSwapchain(VkPhysicalDevice physicalDevice, Allocator* allocator, VkSurfaceKHR surface, VkRenderPass renderPass, GLFWwindow* window, const RenderQuality& quality, Swapchain* oldSwapchain = nullptr);
+    Swapchain CreateOffscreenSwapchain(Allocator* allocator, VkRenderPass renderPass, VkExtent2D extent, uint32_t imageCount, const RenderQuality& quality);
+    // returns the attachments and framebuffers that no longer fit, for the caller to retire
+    Swapchain RebuildSwapchainTargets(Swapchain& swapchain, VkRenderPass renderPass, const RenderQuality& quality);
+    bool SupportsUpscaleBlit(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+    RenderQuality ClampRenderQuality(const VulkanContext& context, RenderQuality quality);
+    // swaps the render pass and swapchain targets for the new quality, pipelines must be requested again by the caller
+    void SetRenderQuality(VulkanContext& context, const RenderQuality& quality);
+    // linear filtered blit between color images already in transfer src and transfer dst layouts
+    void RecordImageBlit(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage destination, VkExtent2D destinationExtent);
     VkSemaphore CreateSemaphore(VkDevice device);
-    VkCommandPool CreateCommandPool(VkDevice device);
+    VkCommandPool CreateCommandPool(VkDevice device, uint32_t queueFamilyIndex);
     VkCommandBuffer AllocateCommandBuffer(VkDevice device, VkCommandPool commandPool);
-    VkPipelineLayout CreatePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts);
+    VkPipelineLayout CreatePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges = {});
+    // no device needed, so it can run on a worker thread before the context exists. empty when the file can't be read
+    std::vector<uint32_t> ReadShaderFile(const char* filename);
+    // null for empty code, the words can come straight out of a mapped asset archive
+    VkShaderModule CreateShaderModule(VkDevice device, std::span<const uint32_t> code);
     VkShaderModule CreateShaderModuleFromFile(VkDevice device, const char* filename);
-    VkPipeline CreateGraphicsPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule, VkViewport viewport, const std::vector<VkVertexInputBindingDescription>& vertexInputBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions);
+    VkPipeline CreateComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout layout, VkShaderModule shaderModule);
+    VkPipeline CreateGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDescription& description);
     VkFence CreateFence(VkDevice device, VkBool32 createAsSigned = VK_FALSE);
     uint32_t GetMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	Buffer CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties);
-	void DestroyBuffer(VkDevice device, Buffer& buffer);
+	// more than one distinct queue family makes the buffer concurrent
+	Buffer CreateBuffer(Allocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, const std::vector<uint32_t>& queueFamilies = {});
+	void DestroyBuffer(Allocator* allocator, Buffer& buffer);
     VkDescriptorSetLayout CreateDescriptorSetLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& setLayoutBindings);
     VkDescriptorPool CreateDescriptorPool(VkDevice device, const std::vector<VkDescriptorPoolSize>& descriptorPools, uint32_t maxSet);
     VkDescriptorSet AllocateDescriptorSet(VkDevice device, VkDescriptorPool descriptorPool, const std::vector<VkDescriptorSetLayout>& setLayout);
     void UpdateUniformBufferDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, const Buffer& buffer);
+    void UpdateDynamicUniformBufferDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, const Buffer& buffer, VkDeviceSize range);
+    void UpdateStorageBufferDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, uint32_t binding, const Buffer& buffer);
     VkVertexInputAttributeDescription CreateAttributeDescription(uint32_t binding, uint32_t location, uint32_t offset, VkFormat format);
     VkVertexInputBindingDescription CreateBindingDescription(uint32_t binding, VkVertexInputRate inputRate, uint32_t stride);
     VkDescriptorSetLayoutBinding CreateSetLayoutBinding(uint32_t binding, uint32_t descriptorCount, VkDescriptorType descriptorType, VkShaderStageFlags shaderStage);
     VkDescriptorPoolSize CreatePoolSize(uint32_t descriptorCount, VkDescriptorType descriptorType);
-    Image CreateImage(VkPhysicalDevice physicalDevice, VkDevice device, int width, int height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samplerCount = VK_SAMPLE_COUNT_1_BIT);
+    Image CreateImage(Allocator* allocator, int width, int height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samplerCount = VK_SAMPLE_COUNT_1_BIT, uint32_t mipLevels = 1,
+        uint32_t layers = 1, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D);
+    // bytes of one tightly packed mip level, the layout staged uploads use
+    VkDeviceSize GetImageLevelSize(VkFormat format, uint32_t width, uint32_t height);
+    void DestroyImage(Allocator* allocator, Image& image);
+    // trilinear and anisotropic over every mip level the image has
     VkSampler CreateSampler(VkDevice device, VkFilter minFilter = VK_FILTER_LINEAR, VkFilter magFilter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
     void ExecuteCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, const std::vector<VkPipelineStageFlags>& waitStageMasks, VkFence fence = VK_NULL_HANDLE, const std::vector<VkSemaphore>& waitSemaphores = {}, const std::vector<VkSemaphore>& signalSemaphores = {});
@@ -45,9 +75,10 @@ namespace vkn
     void BeginSingleTimeCommandBufferRecording(VkCommandBuffer commandBuffer);
     void EndAndExecuteSingleTimeCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue);
 
-    void TransitionLayout(VkDevice device, VkCommandPool commandPool, VkQueue graphicQueue, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage);
+    void TransitionLayout(BarrierBatch& barriers, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags2 srcAccessMask, VkAccessFlags2 dstAccessMask, VkPipelineStageFlags2 srcStage, VkPipelineStageFlags2 dstStage);
 
-    VulkanContext CreateVulkanContext(GLFWwindow* window);
+    // a null window creates a headless context rendering into offscreen images of headlessExtent
+    VulkanContext CreateVulkanContext(GLFWwindow* window, VkExtent2D headlessExtent = {1280, 720}, const RenderQuality& quality = {});
 
     void DestroySwapchain(VkDevice device, Swapchain& swapchain);
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <Vulkan/Types.hpp>
+#include <Macros.hpp>
+
+namespace vkn
+{
+    struct GpuScopeResult
+    {
+        const char* name = nullptr;
+        uint32_t depth = 0;
+        double startMs = 0.0;
+        double durationMs = 0.0;
+    };
+
+    // timestamp queries are read back once their frame slot comes around again,
+    // so results are frameCount - 1 frames late and the read never waits on the gpu
+    class GpuProfiler
+    {
+    public:
+        void Create(const VulkanContext& context, uint32_t frameCount = MAX_FRAMES_IN_FLIGHT + 1, uint32_t maxScopes = 64);
+        void Destroy();
+
+        void BeginFrame(VkCommandBuffer commandBuffer);
+        void EndFrame(VkCommandBuffer commandBuffer);
+
+        void BeginScope(VkCommandBuffer commandBuffer, const char* name);
+        void EndScope(VkCommandBuffer commandBuffer);
+
+        const std::vector<GpuScopeResult>& GetLastResults() const { return mLastResults; }
+        double GetAverage(const char* name) const;
+        double GetLastFrameMs() const { return mLastFrameMs; }
+
+        void PrintAverages() const;
+        void ExportChromeTrace(const char* filename) const;
+
+        bool IsSupported() const { return mSupported; }
+
+    private:
+        struct Scope
+        {
+            const char* name = nullptr;
+            uint32_t depth = 0;
+            uint32_t beginQuery = 0;
+            uint32_t endQuery = 0;
+        };
+
+        struct FrameSlot
+        {
+            std::vector<Scope> scopes;
+            uint32_t queryCount = 0;
+            double cpuBeginUs = 0.0;
+            bool pending = false;
+        };
+
+        struct RollingAverage
+        {
+            static const uint32_t sWindow = 64;
+            double samples[sWindow] = {};
+            double sum = 0.0;
+            uint32_t count = 0;
+            uint32_t next = 0;
+
+            void Add(double value);
+            double Get() const { return count ? sum / count : 0.0; }
+        };
+
+        struct TraceEvent
+        {
+            const char* name = nullptr;
+            double startUs = 0.0;
+            double durationUs = 0.0;
+        };
+
+        void readBack(FrameSlot& slot, uint32_t slotIndex);
+
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkQueryPool mQueryPool = VK_NULL_HANDLE;
+        bool mSupported = false;
+        double mTimestampPeriod = 1.0;
+        uint64_t mTimestampMask = ~0ull;
+
+        uint32_t mFrameCount = 0;
+        uint32_t mMaxScopes = 0;
+        uint32_t mCurrentSlot = 0;
+        bool mRecording = false;
+
+        std::vector<FrameSlot> mSlots;
+        std::vector<uint32_t> mScopeStack;
+
+        std::vector<GpuScopeResult> mLastResults;
+        double mLastFrameMs = 0.0;
+        std::unordered_map<std::string, RollingAverage> mAverages;
+
+        std::vector<TraceEvent> mTraceEvents;
+    };
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+namespace vkn
+{
+    // folds one more field into a hash built from several, the boost mix
+    template<typename T>
+    void HashCombine(size_t& seed, const T& value)
+    {
+        seed ^= std::hash<T>()(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <Vulkan/Types.hpp>
 #include <Vulkan/Functions.hpp>
+#include <Vulkan/UploadManager.hpp>
 
 
 namespace vkn
@@ -20,7 +21,7 @@ namespace vkn
 		const Buffer& GetBuffer() const { return mBuffer; }
 	private:
 		VulkanContext& mContext;
-		Buffer mStagingBuffer;
+		StagingRegion mStagingRegion;
 		Buffer mBuffer;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+#include <vector>
+#include <Vulkan/Types.hpp>
+#include <Macros.hpp>
+
+namespace vkn
+{
+    // matches Object in cull.comp
+    struct IndirectObject
+    {
+        // world space bounding sphere
+        float center[3] = {0.f, 0.f, 0.f};
+        float radius = 0.f;
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t padding = 0;
+    };
+
+    struct CullView
+    {
+        // column major like glm
+        float viewProjection[16];
+        // xyz inward normal and w distance
+        float frustumPlanes[6][4];
+    };
+
+    struct IndirectCullerStats
+    {
+        uint32_t objects = 0;
+        uint32_t occluders = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+        uint32_t drawn = 0;
+    };
+
+    // culls every object on the gpu in two phases and draws the survivors with one indirect call.
+    // the early phase runs on the compute queue and picks the objects the previous frame's late phase found visible as occluders, they are
+    // drawn depth only and reduced to a depth pyramid, then the late phase tests every object against it, so objects rejected last frame get another chance.
+    // a surviving object draws one instance whose firstInstance is its index, so per instance vertex data lines up with the object list
+    class IndirectCuller
+    {
+    public:
+        void Create(const VulkanContext& context, const std::vector<IndirectObject>& objects, uint32_t frameCount = MAX_FRAMES_IN_FLIGHT);
+        void Destroy();
+
+        // recreates the occlusion depth and pyramid when the extent changed, the old ones are retired through the deletion queue
+        void Resize(VkExtent2D extent);
+
+        // the frame's fence must be waited on first, the graphics submit has to wait on the returned semaphore at GetWaitStage
+        // and signal GetLateSemaphore, the next frame's early phase waits on it before reading what the late phase wrote
+        VkSemaphore Cull(uint32_t frameIndex, const CullView& view);
+        VkPipelineStageFlags GetWaitStage() const { return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT; }
+        VkSemaphore GetLateSemaphore(uint32_t frameIndex) const { return mFrames[frameIndex].lateFinished; }
+
+        // the caller binds a depth only pipeline made for GetOcclusionRenderPass and its buffers in between
+        void BeginOcclusionPass(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        void DrawOccluders(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        void EndOcclusionPass(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        void Draw(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        VkRenderPass GetOcclusionRenderPass() const { return mOcclusionRenderPass; }
+        uint32_t GetObjectCount() const { return mObjectCount; }
+
+        // counts come back once the frame slot is reused
+        const IndirectCullerStats& GetLastStats() const { return mLastStats; }
+        void PrintStats() const;
+
+    private:
+        struct Frame
+        {
+            Buffer earlyCommands;
+            Buffer earlyCount;
+            Buffer commands;
+            Buffer count;
+            // written by this frame's late phase, read by the next frame's early phase
+            Buffer visibility;
+            Buffer stats;
+            Buffer cullData;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkSemaphore finished = VK_NULL_HANDLE;
+            VkSemaphore lateFinished = VK_NULL_HANDLE;
+            bool pending = false;
+        };
+
+        struct OcclusionTargets
+        {
+            VkExtent2D extent = {0, 0};
+            Image depth;
+            VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+            VkImage pyramid = VK_NULL_HANDLE;
+            Allocation pyramidAllocation;
+            VkImageView pyramidView = VK_NULL_HANDLE;
+            std::vector<VkImageView> pyramidLevels;
+            VkExtent2D pyramidExtent = {0, 0};
+
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> reduceSets;
+            VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        };
+
+        // matches CullData in cull.comp
+        struct CullData
+        {
+            CullView view;
+            float pyramidSize[2];
+            uint32_t objectCount;
+            uint32_t compact;
+        };
+
+        void createTargets(VkExtent2D extent);
+        // static so retired targets can be destroyed after the culler itself is gone
+        static void destroyTargets(VkDevice device, Allocator* allocator, OcclusionTargets& targets);
+        void drawIndirect(VkCommandBuffer commandBuffer, const Buffer& commands, const Buffer& count);
+
+        VkDevice mDevice = VK_NULL_HANDLE;
+        Allocator* mAllocator = nullptr;
+        DeletionQueue* mDeletionQueue = nullptr;
+        VkQueue mQueue = VK_NULL_HANDLE;
+        // without draw indirect count culled commands are zeroed in place instead of compacted
+        bool mCompact = false;
+        bool mMultiDraw = false;
+        bool mSynchronization2 = false;
+        uint32_t mObjectCount = 0;
+
+        Buffer mObjects;
+        VkSampler mSampler = VK_NULL_HANDLE;
+        VkRenderPass mOcclusionRenderPass = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout mFrameSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout mPyramidSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout mReduceSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+        VkPipelineLayout mCullLayout = VK_NULL_HANDLE;
+        VkPipelineLayout mReduceLayout = VK_NULL_HANDLE;
+        VkPipeline mCullPipeline = VK_NULL_HANDLE;
+        VkPipeline mReducePipeline = VK_NULL_HANDLE;
+
+        std::vector<Frame> mFrames;
+        // the last culled slot, its graphics submit signals the semaphore the next early phase waits on
+        uint32_t mPreviousFrame = UINT32_MAX;
+        // the object list goes through the upload manager, the first cull waits on its copy and clears the visibility buffers
+        VkSemaphore mObjectsUploaded = VK_NULL_HANDLE;
+        bool mInitialized = false;
+        OcclusionTargets mTargets;
+
+        IndirectCullerStats mLastStats;
+        IndirectCullerStats mTotalStats;
+        uint32_t mResolvedFrames = 0;
+    };
+}
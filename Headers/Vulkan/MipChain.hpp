@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace vkn
+{
+    // every level of an rgba8 image down to 1x1, packed one after another the way UploadManager::CopyToImage expects them
+    struct MipChain
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> data;
+        std::vector<size_t> offsets;
+
+        uint32_t GetLevelCount() const { return offsets.size(); }
+        uint32_t GetLevelWidth(uint32_t level) const { return width >> level > 0 ? width >> level : 1; }
+        uint32_t GetLevelHeight(uint32_t level) const { return height >> level > 0 ? height >> level : 1; }
+    };
+
+    uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+    // 2x2 box filter, srgb texels are averaged in linear space so the small levels don't darken
+    MipChain BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb = true);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+namespace vkn
+{
+    VkPipelineCache LoadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const char* filename);
+    void SavePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const char* filename);
+}
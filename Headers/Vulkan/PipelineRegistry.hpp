@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <Vulkan/Types.hpp>
+
+namespace vkn
+{
+    using PipelineHandle = uint32_t;
+
+    struct GraphicsPipelineDescriptionHash
+    {
+        size_t operator()(const GraphicsPipelineDescription& description) const;
+    };
+
+    struct GraphicsPipelineDescriptionEqual
+    {
+        bool operator()(const GraphicsPipelineDescription& a, const GraphicsPipelineDescription& b) const;
+    };
+
+    struct PipelineRegistryStats
+    {
+        uint32_t requests = 0;
+        uint32_t deduplicated = 0;
+        uint32_t compiledOnWorker = 0;
+        uint32_t compiledInline = 0;
+    };
+
+    class PipelineRegistry
+    {
+    public:
+        void Create(VkDevice device, VkPipelineCache pipelineCache, uint32_t workerCount = 0);
+        void Destroy();
+
+        PipelineHandle Request(const GraphicsPipelineDescription& description);
+        VkPipeline Get(PipelineHandle handle);
+        VkPipeline TryGet(PipelineHandle handle) const;
+        // called when a shader module is retired, a new module can get the same handle and must not match pipelines made from the old one.
+        // the pipelines themselves stay valid, the ones still waiting are compiled first since they need the module
+        void ForgetShaderModule(VkShaderModule module);
+
+        PipelineRegistryStats GetStats() const;
+
+    private:
+        enum class State : uint32_t { Queued, Compiling, Ready };
+
+        struct Entry
+        {
+            GraphicsPipelineDescription description;
+            std::atomic<State> state = State::Queued;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+        };
+
+        void workerLoop();
+        void compile(Entry& entry);
+
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+
+        std::deque<Entry> mEntries;
+        std::unordered_map<GraphicsPipelineDescription, PipelineHandle, GraphicsPipelineDescriptionHash, GraphicsPipelineDescriptionEqual> mLookup;
+        std::deque<PipelineHandle> mQueue;
+
+        std::vector<std::thread> mWorkers;
+        mutable std::mutex mMutex;
+        std::condition_variable mQueueCondition;
+        std::condition_variable mReadyCondition;
+        bool mStopping = false;
+
+        PipelineRegistryStats mStats;
+    };
+}
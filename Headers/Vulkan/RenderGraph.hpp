@@ -0,0 +1,203 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <span>
+#include <Vulkan/Types.hpp>
+#include <Vulkan/BarrierBatch.hpp>
+
+namespace vkn
+{
+    using RenderGraphResource = uint32_t;
+
+    // how a pass touches an image, the layout is the one it expects while the pass runs
+    struct RenderGraphUsage
+    {
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    namespace RenderGraphUsages
+    {
+        inline const RenderGraphUsage ColorAttachment = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        inline const RenderGraphUsage DepthAttachment = {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        inline const RenderGraphUsage DepthRead = {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        inline const RenderGraphUsage ShaderRead = {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        inline const RenderGraphUsage StorageWrite = {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        inline const RenderGraphUsage TransferSrc = {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        inline const RenderGraphUsage TransferDst = {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+    }
+
+    struct RenderGraphTextureDescription
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags usage = 0;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    struct RenderGraphStats
+    {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t barrierCount = 0;
+        uint32_t transientCount = 0;
+        uint32_t memorySlotCount = 0;
+        // what the transients would take without aliasing against what was actually allocated
+        VkDeviceSize transientBytes = 0;
+        VkDeviceSize allocatedBytes = 0;
+    };
+
+    class RenderGraph;
+
+    class RenderGraphBuilder
+    {
+    public:
+        // graph owned image that only lives between its first and last use, its memory is shared with transients that don't overlap
+        RenderGraphResource CreateTexture(const char* name, const RenderGraphTextureDescription& description);
+        void Read(RenderGraphResource resource, const RenderGraphUsage& usage);
+        // layoutAfter is for passes that transition on their own, like a render pass final layout
+        void Write(RenderGraphResource resource, const RenderGraphUsage& usage, VkImageLayout layoutAfter = VK_IMAGE_LAYOUT_UNDEFINED);
+        // keeps the pass even when nothing reads what it writes
+        void SetSideEffect();
+
+    private:
+        friend class RenderGraph;
+        RenderGraphBuilder(RenderGraph& graph, uint32_t passIndex) : mGraph(graph), mPassIndex(passIndex) {}
+
+        RenderGraph& mGraph;
+        uint32_t mPassIndex;
+    };
+
+    // passes are declared again every frame, Compile orders them, culls the ones nothing depends on,
+    // derives the barriers between them and places transient images in aliased memory.
+    // pass names must outlive the frame, the gpu profiler reads them back later
+    class RenderGraph
+    {
+    public:
+        void Create(const VulkanContext& context);
+        void Destroy();
+
+        void Reset();
+
+        RenderGraphResource ImportImage(const char* name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect,
+            VkImageLayout initialLayout, VkPipelineStageFlags2 initialStage, VkImageLayout finalLayout);
+        void AddPass(const char* name, const std::function<void(RenderGraphBuilder&)>& setup, std::function<void(VkCommandBuffer)>&& execute);
+
+        void Compile();
+        void Execute(VkCommandBuffer commandBuffer);
+
+        VkImage GetImage(RenderGraphResource resource) const { return mResources[resource].image; }
+        VkImageView GetImageView(RenderGraphResource resource) const { return mResources[resource].imageView; }
+
+        // render passes over transients need a framebuffer per placement, they are cached until the transients move again.
+        // attachments that come from outside the graph have to call ReleaseFramebuffers when they are recreated
+        VkFramebuffer GetFramebuffer(VkRenderPass renderPass, std::span<const VkImageView> attachments, VkExtent2D extent);
+        void ReleaseFramebuffers();
+
+        RenderGraphStats GetStats() const;
+        void PrintCompiled() const;
+
+    private:
+        friend class RenderGraphBuilder;
+
+        struct Access
+        {
+            RenderGraphResource resource = 0;
+            RenderGraphUsage usage;
+            VkImageLayout layoutAfter = VK_IMAGE_LAYOUT_UNDEFINED;
+            bool write = false;
+        };
+
+        struct Pass
+        {
+            const char* name = nullptr;
+            std::vector<Access> accesses;
+            std::function<void(VkCommandBuffer)> execute;
+            bool sideEffect = false;
+            bool culled = false;
+            BarrierBatch barriers;
+            uint32_t barrierCount = 0;
+        };
+
+        struct Resource
+        {
+            const char* name = nullptr;
+            bool imported = false;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView imageView = VK_NULL_HANDLE;
+            VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+            VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2 initialStage = VK_PIPELINE_STAGE_2_NONE;
+            RenderGraphTextureDescription description;
+
+            // positions in the compiled order
+            uint32_t firstUse = UINT32_MAX;
+            uint32_t lastUse = 0;
+            uint32_t physicalIndex = UINT32_MAX;
+        };
+
+        struct ResourceState
+        {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 access = 0;
+            bool written = false;
+            bool touched = false;
+        };
+
+        struct PhysicalImage
+        {
+            RenderGraphTextureDescription description;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView imageView = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            uint32_t slot = 0;
+            uint32_t firstUse = 0;
+            uint32_t lastUse = 0;
+        };
+
+        struct Framebuffer
+        {
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            std::vector<VkImageView> attachments;
+            VkExtent2D extent = {};
+            VkFramebuffer handle = VK_NULL_HANDLE;
+        };
+
+        struct MemorySlot
+        {
+            Allocation allocation;
+            VkDeviceSize size = 0;
+            VkDeviceSize alignment = 1;
+            uint32_t memoryTypeBits = UINT32_MAX;
+            // how the last occupant was used when the previous frame ended, the next frame's first occupant waits on just that
+            ResourceState lastState;
+        };
+
+        void cullPasses();
+        void sortPasses();
+        void placeTransients();
+        void computeBarriers();
+        void releasePhysical();
+
+        Allocator* mAllocator = nullptr;
+        DeletionQueue* mDeletionQueue = nullptr;
+        GpuProfiler* mGpuProfiler = nullptr;
+        bool mSynchronization2 = false;
+
+        std::vector<Pass> mPasses;
+        std::vector<Resource> mResources;
+        std::vector<uint32_t> mOrder;
+        BarrierBatch mFinalBarriers;
+        uint32_t mFinalBarrierCount = 0;
+
+        // kept across frames while the transient layout is unchanged, images can't be rebound to other memory
+        std::vector<PhysicalImage> mPhysicalImages;
+        std::vector<MemorySlot> mMemorySlots;
+        size_t mPhysicalSignature = 0;
+        std::vector<Framebuffer> mFramebuffers;
+    };
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Vulkan/Types.hpp>
+#include <Vulkan/Texture.hpp>
+#include <Vulkan/TextureArray.hpp>
+
+namespace vkn
+{
+    using ResourceHandle = uint32_t;
+
+    struct ResourceCacheStats
+    {
+        uint32_t requests = 0;
+        // the path was already loaded, nothing was read
+        uint32_t pathHits = 0;
+        // another path with the same bytes, read and hashed but not created again
+        uint32_t contentHits = 0;
+        uint32_t created = 0;
+        // device memory and shader code the hits didn't create again
+        uint64_t bytesSaved = 0;
+        uint32_t live = 0;
+    };
+
+    // shares textures, samplers and shader modules between everything that loads them. a load looks for a live resource by path first,
+    // then by the hash of the file's bytes, so copies of one file under different names end up as one object.
+    // a hash match is only taken when the bytes match too, a collision creates a second object.
+    // every load takes a reference, the last Release retires the object through the deletion queue.
+    // file reads and hashing run outside the lock, creation is serialized
+    class ResourceCache
+    {
+    public:
+        void Create(const VulkanContext& context);
+        // destroys whatever is still referenced, the device must be idle
+        void Destroy();
+
+        // UINT32_MAX when the file can't be read or decoded
+        ResourceHandle LoadTexture(const char* filename);
+        // takes a texture array that Load and Create already made, its loading overlaps device creation so it can't go through the cache.
+        // when the directory is already live the new array is destroyed and the live one is shared
+        ResourceHandle AddTextureArray(const char* directory, TextureArray&& textureArray);
+        ResourceHandle LoadShaderModule(const char* filename);
+        // spir-v that is already in memory, like a span into the asset archive, name is the path it would have on disk
+        ResourceHandle LoadShaderModule(const char* name, std::span<const uint32_t> code);
+        // keyed by its parameters, there is no file behind it
+        ResourceHandle LoadSampler(VkFilter minFilter = VK_FILTER_LINEAR, VkFilter magFilter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
+        // another reference for a second owner, it needs its own Release
+        ResourceHandle Acquire(ResourceHandle handle);
+        void Release(ResourceHandle handle);
+
+        // the getters return null objects for UINT32_MAX, so a failed load doesn't have to be checked before use
+        Image GetImage(ResourceHandle handle) const;
+        // the texture's or texture array's slot in the descriptor heap
+        uint32_t GetTextureIndex(ResourceHandle handle) const;
+        VkShaderModule GetShaderModule(ResourceHandle handle) const;
+        VkSampler GetSampler(ResourceHandle handle) const;
+
+        ResourceCacheStats GetStats() const;
+        void PrintStats() const;
+
+    private:
+        enum class Kind : uint32_t { Texture, ShaderModule, Sampler, TextureArray };
+
+        struct Entry
+        {
+            Kind kind = Kind::Texture;
+            uint32_t references = 0;
+            uint64_t key = 0;
+            // what a hit saves, the image's mip chain or the spir-v
+            uint64_t bytes = 0;
+            // what the key was hashed from, compared on a hash match
+            std::vector<uint8_t> content;
+            std::vector<std::string> paths;
+
+            Texture texture;
+            // shared so the entry stays copyable for the deletion queue
+            std::shared_ptr<TextureArray> textureArray;
+            VkShaderModule shaderModule = VK_NULL_HANDLE;
+            VkSampler sampler = VK_NULL_HANDLE;
+        };
+
+        // both expect the lock held and add a reference on a hit
+        ResourceHandle findPath(Kind kind, const std::string& path);
+        ResourceHandle findContent(Kind kind, uint64_t key, std::span<const uint8_t> content, const std::string& path);
+        ResourceHandle addEntry(Entry&& entry, const std::string& path);
+        // static so retired entries can be destroyed from the deletion queue after the cache is gone
+        static void destroyEntry(VkDevice device, Entry& entry);
+
+        VulkanContext mContext;
+
+        std::deque<Entry> mEntries;
+        std::vector<ResourceHandle> mFreeEntries;
+        std::unordered_map<std::string, ResourceHandle> mPaths;
+        std::unordered_map<uint64_t, ResourceHandle> mContents;
+
+        mutable std::mutex mMutex;
+        ResourceCacheStats mStats;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Vulkan/Types.hpp"
+#include <Vulkan/UploadManager.hpp>
 
 namespace vkn
 {
@@ -7,21 +8,29 @@ namespace vkn
     class Texture
     {
         public:
-            void Create(VulkanContext context, int width, int height);
+            void Create(VulkanContext context, int width, int height, uint32_t mipLevels = 1);
+            // loads the file and uploads it with a full mip chain
             void CreateFromFile(VulkanContext context, const char* filename);
+            // same for a file that is already in memory, name is only for the error message
+            void CreateFromMemory(VulkanContext context, const uint8_t* data, size_t size, const char* name);
+            // the image may still be in use by frames in flight, retire it through the deletion queue in that case
+            void Destroy();
 
+            // data holds every mip level packed one after another, see MipChain
             void SetData(void* data);
 
             void StageData(void* data);
             void PushData();
 
             const Image& GetImage() const { return mImage; };
-            VkSampler GetSampler() const { return mSampler; }
+            uint32_t GetIndex() const { return mIndex; }
 
         private:
+            void createFromPixels(VulkanContext context, const uint8_t* pixels, int width, int height);
+
             Image mImage;
-            Buffer mStagingBuffer;
-            VkSampler mSampler;
+            StagingRegion mStagingRegion;
+            uint32_t mIndex = 0;
             VulkanContext mContext;
     };
 
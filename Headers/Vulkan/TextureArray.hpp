@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <future>
+#include <unordered_map>
+#include <Vulkan/Types.hpp>
+#include <Vulkan/MipChain.hpp>
+#include <Vulkan/TextureCache.hpp>
+
+class JobPool;
+class AssetArchive;
+struct AssetArchiveEntry;
+
+namespace vkn
+{
+    struct TextureArrayStats
+    {
+        uint32_t layers = 0;
+        uint32_t cachedLayers = 0;
+        uint32_t rebuiltLayers = 0;
+        // Profiler::NowUs of the first layer job starting and the last one finishing, and the time spent in all of them
+        double loadBeginUs = 0.0;
+        double loadEndUs = 0.0;
+        double loadBusyUs = 0.0;
+    };
+
+    // packs every png under a directory into one 2d array image with a full mip chain, registered once in the descriptor heap.
+    // layers are named by their path relative to the directory without the extension, like "Orange/texture_01",
+    // files that don't match the size of the first one are skipped
+    class TextureArray
+    {
+    public:
+        // lists the layers on the calling thread and decodes them on the pool, nothing here needs the device so it can overlap its creation.
+        // with a cache directory the layers are read as bc1 from there, stale or missing entries are compressed and saved.
+        // an archive that packs the directory is used instead of the loose files, it has to stay open until Create
+        void Load(JobPool& jobPool, const char* directory, const char* cacheDirectory = nullptr, const AssetArchive* archive = nullptr);
+        // waits for the loads and uploads them, bc1 layers are decoded again as rgba8 when the device can't sample them
+        void Create(const VulkanContext& context);
+        // Load and Create in one go on the calling thread
+        void CreateFromDirectory(const VulkanContext& context, const char* directory, const char* cacheDirectory = nullptr);
+        void Destroy();
+
+        // prints and falls back to layer 0 for unknown names, valid once Load returned
+        uint32_t GetLayer(const std::string& name) const;
+        uint32_t GetLayerCount() const { return mLayers.size(); }
+
+        const Image& GetImage() const { return mImage; }
+        uint32_t GetIndex() const { return mIndex; }
+        // filled by Create
+        const TextureArrayStats& GetStats() const { return mStats; }
+
+    private:
+        struct LayerData
+        {
+            MipChain mipChain;
+            CompressedTexture compressed;
+            bool fromCache = false;
+            double beginUs = 0.0;
+            double endUs = 0.0;
+        };
+
+        // a packed layer has its archive entry, a loose one only the path
+        struct LayerSource
+        {
+            std::string path;
+            const AssetArchiveEntry* entry = nullptr;
+        };
+
+        // the cache is checked against the source's hash, which a packed layer already has in its archive entry
+        static LayerData loadLayer(const AssetArchive* archive, const LayerSource& source, const std::string& cachePath, uint32_t width, uint32_t height);
+
+        VulkanContext mContext;
+        Image mImage;
+        uint32_t mIndex = 0;
+        std::unordered_map<std::string, uint32_t> mLayers;
+        TextureArrayStats mStats;
+
+        std::string mDirectory;
+        std::string mCacheDirectory;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        const AssetArchive* mArchive = nullptr;
+        std::vector<LayerSource> mLayerSources;
+        std::vector<std::future<LayerData>> mPendingLayers;
+    };
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <Vulkan/MipChain.hpp>
+
+namespace vkn
+{
+    // bc1 copy of a source image with every mip level, so startup can skip png decoding and upload 8 bytes per 4x4 block
+    struct CompressedTexture
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        // blocks of every level packed one after another
+        std::vector<uint8_t> data;
+    };
+
+    uint32_t GetBC1LevelSize(uint32_t width, uint32_t height);
+
+    // endpoints are fit along the principal axis of each block, in the same srgb space the hardware interpolates in.
+    // edge blocks of sizes that aren't a multiple of 4 repeat their last row and column
+    void CompressBC1(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks);
+    CompressedTexture CompressTexture(const MipChain& mipChain);
+
+    std::string GetTextureCachePath(const std::string& cacheDirectory, const std::string& name);
+
+    // entries are keyed on HashAssetData of the encoded source, so a loose png and the same png packed in Assets.pak share one entry.
+    // false when the entry is missing, from another format version, or was saved from different source bytes
+    bool LoadTextureCache(const std::string& path, uint64_t sourceHash, CompressedTexture& texture);
+    bool SaveTextureCache(const std::string& path, uint64_t sourceHash, const CompressedTexture& texture);
+}
@@ -1,9 +1,18 @@
 #pragma once
 #include <vector>
 #include <vulkan/vulkan.h>
+#include "Allocator.hpp"
 
 namespace vkn
 {
+    class UploadManager;
+    class PipelineRegistry;
+    class CommandAllocator;
+    class DescriptorHeap;
+    class GpuProfiler;
+    class DeletionQueue;
+    class ResourceCache;
+
     struct QueueIndices
     {
         uint32_t graphic = UINT32_MAX;
@@ -12,6 +21,17 @@ namespace vkn
         uint32_t compute = UINT32_MAX;
     };
 
+    struct DeviceFeatures
+    {
+        bool synchronization2 = false;
+        bool multiDrawIndirect = false;
+        // vkCmdDrawIndexedIndirectCount, only set together with multiDrawIndirect
+        bool drawIndirectCount = false;
+        // bc1 through bc7 sampled images
+        bool textureCompressionBC = false;
+        bool swapchain = true;
+    };
+
     struct Queues
     {
         VkQueue graphic = VK_NULL_HANDLE;
@@ -23,37 +43,59 @@ namespace vkn
 
     struct Image
     {
-        VkImage handle;
-        VkImageView imageView;
-        VkDeviceMemory memory;
+        VkImage handle = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        Allocation allocation;
         int width, height;
         VkFormat format;
+        uint32_t mipLevels = 1;
+        uint32_t layers = 1;
+    };
+
+    struct RenderQuality
+    {
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_4_BIT;
+        // internal resolution relative to the swapchain, anything but 1 renders offscreen and blits up
+        float renderScale = 1.f;
+        // stores depth and makes it sampleable, only for when a later pass reads it
+        bool keepDepth = false;
+    };
+
+    struct RenderPassVariant
+    {
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool keepDepth = false;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
     };
 
     struct Swapchain
     {
         VkSwapchainKHR handle = VK_NULL_HANDLE;
         VkExtent2D extent;
+        // what the render pass draws at, extent scaled by the render quality
+        VkExtent2D renderExtent;
+        RenderQuality quality;
         
         std::vector<VkImage> images;
         std::vector<VkImageView> imageViews;
         std::vector<VkFramebuffer> framebuffers;
         
-        VkImage depthImage;
-        VkDeviceMemory depthImageMemory;
-        VkImageView depthImageView;
-
-        VkImage colorImage;
-        VkDeviceMemory colorImageMemory;
-        VkImageView colorImageView;
+        // size dependent attachments, handed over to the next swapchain when the extent is unchanged
+        Image depthImage;
+        Image colorImage;
 
         Image normalImage;
+
+        Allocator* allocator = nullptr;
+        // headless contexts render into these instead of presentable images
+        std::vector<Image> offscreenImages;
     };
 
     struct Buffer
     {
         VkBuffer handle;
-        VkDeviceMemory memory;
+        Allocation allocation;
         VkDeviceSize bufferSize;
         VkDeviceSize size;
         VkBufferUsageFlags usage;
@@ -62,17 +104,47 @@ namespace vkn
         void* map = nullptr;
     };
 
+    struct GraphicsPipelineDescription
+    {
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkShaderModule vertexShaderModule = VK_NULL_HANDLE;
+        VkShaderModule fragmentShaderModule = VK_NULL_HANDLE;
+        std::vector<VkVertexInputBindingDescription> vertexBindings;
+        std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+        VkBool32 blendEnable = VK_FALSE;
+        VkBool32 depthTest = VK_TRUE;
+        VkBool32 depthWrite = VK_TRUE;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+        VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
     struct VulkanContext
     {
         VkInstance instance = VK_NULL_HANDLE;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         VkDevice device = VK_NULL_HANDLE;
+        bool headless = false;
+        DeviceFeatures features;
         QueueIndices queueIndices;
         Queues queues;
         Swapchain swapchain;
         VkCommandPool commandPool = VK_NULL_HANDLE;
         VkSurfaceKHR surface = VK_NULL_HANDLE;
         VkRenderPass renderPass = VK_NULL_HANDLE;
+        RenderQuality quality;
+        std::vector<RenderPassVariant> renderPasses;
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        Allocator* allocator = nullptr;
+        UploadManager* uploadManager = nullptr;
+        PipelineRegistry* pipelineRegistry = nullptr;
+        CommandAllocator* commandAllocator = nullptr;
+        DescriptorHeap* descriptorHeap = nullptr;
+        GpuProfiler* gpuProfiler = nullptr;
+        DeletionQueue* deletionQueue = nullptr;
+        ResourceCache* resourceCache = nullptr;
     };
 
     
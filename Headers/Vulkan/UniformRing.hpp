@@ -0,0 +1,47 @@
+#pragma once
+#include <cstring>
+#include <Vulkan/Types.hpp>
+
+namespace vkn
+{
+    struct UniformAllocation
+    {
+        void* map = nullptr;
+        uint32_t offset = 0;
+    };
+
+    // one persistently mapped uniform buffer split into a linear region per frame in flight,
+    // allocations are bound through dynamic offsets so the descriptor set is written once
+    class UniformRing
+    {
+    public:
+        void Create(Allocator* allocator, VkDeviceSize frameSize, uint32_t frameCount);
+        void Destroy();
+
+        void BeginFrame(uint32_t frameIndex);
+        // aborts when the frame's region is full, size frameSize for the most a frame ever pushes
+        UniformAllocation Allocate(VkDeviceSize size);
+
+        template<typename T>
+        uint32_t Push(const T& data)
+        {
+            UniformAllocation allocation = Allocate(sizeof(T));
+            memcpy(allocation.map, &data, sizeof(T));
+            return allocation.offset;
+        }
+
+        const Buffer& GetBuffer() const { return mBuffer; }
+        VkDeviceSize GetAlignment() const { return mAlignment; }
+
+    private:
+        Allocator* mAllocator = nullptr;
+        Buffer mBuffer;
+
+        VkDeviceSize mAlignment = 0;
+        VkDeviceSize mFrameSize = 0;
+        uint32_t mFrameCount = 0;
+
+        VkDeviceSize mFrameBegin = 0;
+        VkDeviceSize mHead = 0;
+    };
+}
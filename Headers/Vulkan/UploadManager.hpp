@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <Vulkan/Types.hpp>
+#include <Vulkan/CommandAllocator.hpp>
+#include <Vulkan/BarrierBatch.hpp>
+
+namespace vkn
+{
+    struct StagingRegion
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    class UploadManager
+    {
+    public:
+        void Create(const VulkanContext& context, VkDeviceSize stagingSize = 32ull * 1024 * 1024);
+        void Destroy();
+
+        StagingRegion Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+        void CopyToBuffer(const StagingRegion& region, const Buffer& buffer, VkDeviceSize dstOffset, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+        // fills every mip level of one layer, the layer is transitioned on its own so the others can be uploaded later
+        void CopyToImage(const StagingRegion& region, const Image& image, uint32_t layer = 0);
+        // for a buffer created concurrent with the transfer family and read on another queue than the graphic one, so no barriers are recorded.
+        // the reading queue waits on the semaphore Submit returns instead of on the next Flush
+        void CopyToSharedBuffer(const StagingRegion& region, const Buffer& buffer, VkDeviceSize dstOffset);
+        // submits what was recorded so far, the semaphore is recycled like the ones Flush hands out
+        VkSemaphore Submit();
+
+        void Flush(VkCommandBuffer commandBuffer, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages);
+        void WaitIdle();
+
+    private:
+        struct Batch
+        {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            uint64_t ringEnd = 0;
+            std::vector<Buffer> overflowBuffers;
+            bool submitted = false;
+        };
+
+        struct BufferCopy
+        {
+            VkBuffer src = VK_NULL_HANDLE;
+            VkBuffer dst = VK_NULL_HANDLE;
+            VkBufferCopy copy = {};
+        };
+
+        struct ImageCopy
+        {
+            VkBuffer src = VK_NULL_HANDLE;
+            VkImage dst = VK_NULL_HANDLE;
+            VkBufferImageCopy copy = {};
+        };
+
+        void beginBatch();
+        void submit(VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+        void retireBatches(bool wait);
+        VkSemaphore getSemaphore();
+        bool isOwnershipTransfer() const { return mContext.queueIndices.transfer != mContext.queueIndices.graphic; }
+
+        VulkanContext mContext;
+        CommandAllocator mCommandAllocator;
+
+        Buffer mRing;
+        uint64_t mHead = 0;
+        uint64_t mTail = 0;
+
+        std::vector<Batch> mBatches;
+        uint32_t mCurrentBatch = 0;
+        uint32_t mOldestBatch = 0;
+        bool mRecording = false;
+
+        // copies are deferred until submit so every barrier of a batch lands in one call before and one after them
+        BarrierBatch mPreCopyBarriers;
+        BarrierBatch mPostCopyBarriers;
+        std::vector<BufferCopy> mBufferCopies;
+        std::vector<ImageCopy> mImageCopies;
+
+        BarrierBatch mPendingAcquire;
+        BarrierBatch mSubmittedAcquire;
+
+        std::vector<VkSemaphore> mSignaledSemaphores;
+        std::vector<VkSemaphore> mFreeSemaphores;
+        std::vector<std::pair<VkSemaphore, uint64_t>> mConsumedSemaphores;
+        uint64_t mFlushCount = 0;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Types.hpp"
+#include <Vulkan/UploadManager.hpp>
 
 namespace vkn
 {
@@ -18,7 +19,7 @@ namespace vkn
 		const Buffer& GetBuffer() const { return mBuffer; }
 	private:
 		VulkanContext& mContext;
-		Buffer mStagingBuffer;
+		StagingRegion mStagingRegion;
 		Buffer mBuffer;
 	};
 }
\ No newline at end of file
@@ -140,10 +140,15 @@ struct Input
     struct WindowInput
     {
         bool close = false;
+        // set for a single update once the framebuffer size has settled
         bool resize = false;
+        // the framebuffer is still changing size, resize fires once it settles
+        bool resizing = false;
         bool minimized = false;
         bool maximized = false;
         glm::uvec2 size = glm::uvec2(0);
+        // in pixels, differs from size on scaled displays
+        glm::uvec2 framebufferSize = glm::uvec2(0);
     };
     
     MouseInput mouse;
@@ -154,6 +159,10 @@ struct Input
 struct WindowUserPointer
 {
     Input input;
+    glm::uvec2 pendingFramebufferSize = glm::uvec2(0);
+    double lastResizeTime = 0.0;
+    bool resizePending = false;
+    bool iconified = false;
 };
 
 class Window
@@ -174,10 +183,12 @@ class Window
 
     private:
 		void updateKeyboardInput();
+		void updateWindowInput();
         static uint32_t sWindowCount;
         static bool sGlfwInitialized;
-        GLFWwindow* mWindow;
+        GLFWwindow* mWindow = nullptr;
         WindowUserPointer mUserPointer;
 };
 
-void PollEvent();
\ No newline at end of file
+void PollEvent();
+void WaitEvent(double timeout);
\ No newline at end of file
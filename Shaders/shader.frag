@@ -1,13 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec4 outputColor;
 
 layout(location = 0) in vec3 normal;
 layout(location = 1) in vec2 uv;
+layout(location = 2) flat in uvec3 material;
+layout(location = 3) in float shade;
 
-layout(set = 1, binding = 1) uniform sampler2D tex0;
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+layout(set = 1, binding = 2) uniform texture2DArray textureArrays[];
 
 void main()
 {
-    outputColor = texture(tex0, uv);
+    outputColor = texture(sampler2DArray(textureArrays[nonuniformEXT(material.x)], samplers[nonuniformEXT(material.y)]), vec3(uv, material.z));
+    outputColor.rgb *= shade;
 }
\ No newline at end of file
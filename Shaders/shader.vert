@@ -1,13 +1,15 @@
 #version 450
 
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
-layout(location = 2) in vec2 aUv;
+// the packed Vertex from Game.cpp, see PackVertex for the bit layout
+layout(location = 0) in uvec2 aPacked;
 
 layout(location = 3) in mat4 models;
+layout(location = 7) in uvec3 aMaterial;
 
 layout(location = 0) out vec3 normal;
 layout(location = 1) out vec2 uv;
+layout(location = 2) flat out uvec3 material;
+layout(location = 3) out float shade;
 
 layout(binding = 0) uniform UniformBufferData{
     mat4 model;
@@ -15,11 +17,21 @@ layout(binding = 0) uniform UniformBufferData{
     mat4 projection;
 } uniformBufferData;
 
-
+// indexed by BlockFace
+const vec3 faceNormals[6] = vec3[](vec3(0, 0, 1), vec3(0, 0, -1), vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, -1, 0), vec3(0, 1, 0));
+const vec2 cornerUvs[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1));
 
 void main()
 {
-    normal = aNormal;
-    uv = aUv;
-    gl_Position = uniformBufferData.projection * uniformBufferData.view * models * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    uvec3 position = uvec3(aPacked.x, aPacked.x >> 6, aPacked.x >> 12) & 63u;
+    uint face = min((aPacked.x >> 18) & 7u, 5u);
+    uint corner = (aPacked.x >> 21) & 3u;
+    uint ao = (aPacked.x >> 23) & 3u;
+    uint layer = aPacked.y & 0xffffu;
+
+    normal = faceNormals[face];
+    uv = cornerUvs[corner];
+    shade = 1.0 - 0.2 * float(ao);
+    material = uvec3(aMaterial.xy, aMaterial.z + layer);
+    gl_Position = uniformBufferData.projection * uniformBufferData.view * models * vec4(vec3(position) - 0.5, 1.0);
+}
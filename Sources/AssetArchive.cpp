@@ -0,0 +1,428 @@
+#include <AssetArchive.hpp>
+#include <Align.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <print>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t MIN_MATCH = 4;
+    constexpr uint32_t MAX_OFFSET = 65535;
+    constexpr uint32_t HASH_BITS = 14;
+
+    uint32_t read32(const uint8_t* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // lengths past the 4 bit field of the token continue in bytes of 255 until one is smaller
+    void writeLength(std::vector<uint8_t>& output, size_t length)
+    {
+        while(length >= 255)
+        {
+            output.push_back(255);
+            length -= 255;
+        }
+        output.push_back(uint8_t(length));
+    }
+
+    bool readLength(const uint8_t*& input, const uint8_t* end, size_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if(input == end)
+                return false;
+            byte = *input++;
+            length += byte;
+        }
+        while(byte == 255);
+        return true;
+    }
+
+    void writeSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalLength, uint32_t offset, size_t matchLength)
+    {
+        size_t matchField = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+        output.push_back(uint8_t((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchField, 15)));
+
+        if(literalLength >= 15)
+            writeLength(output, literalLength - 15);
+        output.insert(output.end(), literals, literals + literalLength);
+
+        // the last sequence is literals only
+        if(matchLength == 0)
+            return;
+
+        output.push_back(uint8_t(offset));
+        output.push_back(uint8_t(offset >> 8));
+        if(matchField >= 15)
+            writeLength(output, matchField - 15);
+    }
+}
+
+uint64_t HashAssetData(std::span<const uint8_t> data)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(uint8_t byte : data)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::vector<uint8_t> CompressAssetData(std::span<const uint8_t> data)
+{
+    std::vector<uint8_t> output;
+    output.reserve(data.size() / 2);
+
+    // latest position of each hashed 4 byte sequence, greedy first match like lz4's fast mode
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+    const uint8_t* begin = data.data();
+    size_t size = data.size();
+    size_t literalStart = 0;
+    size_t position = 0;
+
+    while(size >= MIN_MATCH && position <= size - MIN_MATCH)
+    {
+        uint32_t sequence = read32(begin + position);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        uint32_t candidate = table[slot];
+        table[slot] = position;
+
+        if(candidate == UINT32_MAX || position - candidate > MAX_OFFSET || read32(begin + candidate) != sequence)
+        {
+            position++;
+            continue;
+        }
+
+        size_t matchLength = MIN_MATCH;
+        while(position + matchLength < size && begin[candidate + matchLength] == begin[position + matchLength])
+        {
+            matchLength++;
+        }
+
+        writeSequence(output, begin + literalStart, position - literalStart, position - candidate, matchLength);
+
+        // doesn't pay off, leave it stored
+        if(output.size() >= size)
+            return {};
+
+        position += matchLength;
+        literalStart = position;
+    }
+
+    writeSequence(output, begin + literalStart, size - literalStart, 0, 0);
+    if(output.size() >= size)
+        return {};
+
+    return output;
+}
+
+bool DecompressAssetData(std::span<const uint8_t> compressed, std::span<uint8_t> destination)
+{
+    const uint8_t* input = compressed.data();
+    const uint8_t* inputEnd = input + compressed.size();
+    uint8_t* output = destination.data();
+    uint8_t* outputBegin = output;
+    uint8_t* outputEnd = output + destination.size();
+
+    while(input < inputEnd)
+    {
+        uint8_t token = *input++;
+
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !readLength(input, inputEnd, literalLength))
+            return false;
+
+        if(size_t(inputEnd - input) < literalLength || size_t(outputEnd - output) < literalLength)
+            return false;
+
+        if(literalLength > 0)
+            memcpy(output, input, literalLength);
+        input += literalLength;
+        output += literalLength;
+
+        if(input == inputEnd)
+            break;
+
+        if(inputEnd - input < 2)
+            return false;
+
+        size_t offset = input[0] | (input[1] << 8);
+        input += 2;
+
+        size_t matchLength = token & 15;
+        if(matchLength == 15 && !readLength(input, inputEnd, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+
+        if(offset == 0 || size_t(output - outputBegin) < offset || size_t(outputEnd - output) < matchLength)
+            return false;
+
+        // byte by byte, a match may overlap the bytes it is producing
+        const uint8_t* match = output - offset;
+        for(size_t i = 0; i < matchLength; i++)
+        {
+            output[i] = match[i];
+        }
+        output += matchLength;
+    }
+
+    return output == outputEnd;
+}
+
+bool WriteAssetArchive(const std::string& path, std::vector<AssetArchiveSource>& sources, bool compress)
+{
+    std::sort(sources.begin(), sources.end(), [](const AssetArchiveSource& a, const AssetArchiveSource& b) { return a.name < b.name; });
+
+    for(size_t i = 1; i < sources.size(); i++)
+    {
+        if(sources[i].name == sources[i - 1].name)
+        {
+            std::println("asset archive: {} is packed twice", sources[i].name);
+            return false;
+        }
+    }
+
+    AssetArchiveHeader header;
+    header.entryCount = sources.size();
+    header.indexOffset = sizeof(AssetArchiveHeader);
+    header.namesOffset = header.indexOffset + sizeof(AssetArchiveEntry) * sources.size();
+
+    std::vector<AssetArchiveEntry> entries(sources.size());
+    std::string names;
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        entries[i].nameOffset = names.size();
+        entries[i].nameLength = sources[i].name.size();
+        names += sources[i].name;
+    }
+    header.namesSize = names.size();
+
+    std::vector<std::vector<uint8_t>> blobs(sources.size());
+    uint64_t offset = header.namesOffset + names.size();
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        const std::vector<uint8_t>& data = sources[i].data;
+        AssetArchiveEntry& entry = entries[i];
+        entry.size = data.size();
+        entry.hash = HashAssetData(data);
+
+        if(compress)
+        {
+            std::vector<uint8_t> compressed = CompressAssetData(data);
+            if(!compressed.empty() && compressed.size() <= data.size() - data.size() / 8)
+            {
+                entry.compression = AssetCompression::LZ;
+                blobs[i] = std::move(compressed);
+            }
+        }
+
+        entry.storedSize = entry.compression == AssetCompression::None ? data.size() : blobs[i].size();
+        entry.offset = AlignUp(offset, ASSET_ARCHIVE_ALIGNMENT);
+        offset = entry.offset + entry.storedSize;
+    }
+
+    // written next to the target and renamed over it, so a mapped archive is never seen half written
+    std::string temporaryPath = path + ".tmp";
+    FILE* fp = fopen(temporaryPath.c_str(), "wb");
+    if(fp == NULL)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+    written = written && (entries.empty() || fwrite(entries.data(), sizeof(AssetArchiveEntry) * entries.size(), 1, fp) == 1);
+    written = written && (names.empty() || fwrite(names.data(), names.size(), 1, fp) == 1);
+
+    uint64_t position = header.namesOffset + names.size();
+    const uint8_t zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+    for(size_t i = 0; i < sources.size() && written; i++)
+    {
+        const std::vector<uint8_t>& blob = entries[i].compression == AssetCompression::None ? sources[i].data : blobs[i];
+        written = entries[i].offset == position || fwrite(zeros, entries[i].offset - position, 1, fp) == 1;
+        written = written && (blob.empty() || fwrite(blob.data(), blob.size(), 1, fp) == 1);
+        position = entries[i].offset + blob.size();
+    }
+
+    written = fclose(fp) == 0 && written;
+    if(!written)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+bool AssetArchive::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    const void* data = nullptr;
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping != nullptr)
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if(data == nullptr)
+    {
+        if(mapping != nullptr)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        std::println("asset archive: can't map {}", path);
+        return false;
+    }
+
+    mFile = file;
+    mMapping = mapping;
+    mSize = fileSize.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if(file < 0)
+        return false;
+
+    struct stat status;
+    void* data = MAP_FAILED;
+    if(fstat(file, &status) == 0 && status.st_size > 0)
+        data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // the mapping keeps the file alive on its own
+    close(file);
+    if(data == MAP_FAILED)
+    {
+        std::println("asset archive: can't map {}", path);
+        return false;
+    }
+
+    mSize = status.st_size;
+#endif
+
+    mData = static_cast<const uint8_t*>(data);
+    mPath = path;
+
+    AssetArchiveHeader header;
+    bool valid = mSize >= sizeof(header);
+    if(valid)
+    {
+        memcpy(&header, mData, sizeof(header));
+        valid = memcmp(header.magic, AssetArchiveHeader().magic, sizeof(header.magic)) == 0 && header.version == ASSET_ARCHIVE_VERSION &&
+            header.indexOffset % alignof(AssetArchiveEntry) == 0 && header.indexOffset <= mSize &&
+            (mSize - header.indexOffset) / sizeof(AssetArchiveEntry) >= header.entryCount &&
+            header.namesOffset <= mSize && mSize - header.namesOffset >= header.namesSize;
+    }
+
+    if(valid)
+    {
+        mEntries = std::span<const AssetArchiveEntry>(reinterpret_cast<const AssetArchiveEntry*>(mData + header.indexOffset), header.entryCount);
+        mNames = reinterpret_cast<const char*>(mData + header.namesOffset);
+
+        for(size_t i = 0; i < mEntries.size() && valid; i++)
+        {
+            const AssetArchiveEntry& entry = mEntries[i];
+            valid = entry.nameOffset <= header.namesSize && header.namesSize - entry.nameOffset >= entry.nameLength &&
+                entry.offset <= mSize && mSize - entry.offset >= entry.storedSize &&
+                (entry.compression == AssetCompression::LZ || (entry.compression == AssetCompression::None && entry.storedSize == entry.size)) &&
+                (i == 0 || GetName(mEntries[i - 1]) < GetName(entry));
+        }
+    }
+
+    if(!valid)
+    {
+        std::println("asset archive: {} is broken or from another version", path);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void AssetArchive::Close()
+{
+    if(mData == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+    CloseHandle(mMapping);
+    CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+    mEntries = {};
+    mNames = nullptr;
+    mPath.clear();
+}
+
+const AssetArchiveEntry* AssetArchive::Find(std::string_view name) const
+{
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), name, [this](const AssetArchiveEntry& entry, std::string_view name) { return GetName(entry) < name; });
+    if(it == mEntries.end() || GetName(*it) != name)
+        return nullptr;
+
+    return &*it;
+}
+
+std::string_view AssetArchive::GetName(const AssetArchiveEntry& entry) const
+{
+    return std::string_view(mNames + entry.nameOffset, entry.nameLength);
+}
+
+std::span<const uint8_t> AssetArchive::GetData(std::string_view name) const
+{
+    const AssetArchiveEntry* entry = Find(name);
+    if(entry == nullptr)
+        return {};
+
+    return GetData(*entry);
+}
+
+std::span<const uint8_t> AssetArchive::GetData(const AssetArchiveEntry& entry) const
+{
+    if(entry.compression != AssetCompression::None)
+        return {};
+
+    return std::span<const uint8_t>(mData + entry.offset, entry.storedSize);
+}
+
+bool AssetArchive::Read(const AssetArchiveEntry& entry, std::span<uint8_t> destination) const
+{
+    if(destination.size() != entry.size)
+        return false;
+
+    std::span<const uint8_t> stored(mData + entry.offset, entry.storedSize);
+    if(entry.compression == AssetCompression::LZ)
+        return DecompressAssetData(stored, destination);
+
+    if(!stored.empty())
+        memcpy(destination.data(), stored.data(), stored.size());
+    return true;
+}
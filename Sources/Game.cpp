@@ -1,21 +1,39 @@
 #include <Game.hpp>
 #include "../Headers/Vulkan/VertexBuffer.hpp"
-#include "Vulkan/Texture.hpp"
+#include <Vulkan/TextureArray.hpp>
 #include <Vulkan/IndexBuffer.hpp>
+#include <Vulkan/UploadManager.hpp>
+#include <Vulkan/PipelineCache.hpp>
+#include <Vulkan/PipelineRegistry.hpp>
+#include <Vulkan/CommandAllocator.hpp>
+#include <Vulkan/UniformRing.hpp>
+#include <Vulkan/DescriptorHeap.hpp>
+#include <Vulkan/GpuProfiler.hpp>
+#include <Vulkan/DeletionQueue.hpp>
+#include <Vulkan/RenderGraph.hpp>
+#include <Vulkan/IndirectCuller.hpp>
+#include <Vulkan/ResourceCache.hpp>
+#include <JobPool.hpp>
+#include <AssetArchive.hpp>
+#include <Profiler.hpp>
 #include <stb/stb_image.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <format>
+#include <mutex>
 
 
 struct FrameData
 {
-    VkCommandBuffer commandBuffer;
     VkSemaphore imageAcquiredSemaphore;
     VkFence renderedFence;
 };
 
-FrameData CreateFrameData(VkDevice device, VkCommandPool commandPool)
+FrameData CreateFrameData(VkDevice device)
 {
     FrameData data;
-    data.commandBuffer = vkn::AllocateCommandBuffer(device, commandPool);
     data.imageAcquiredSemaphore = vkn::CreateSemaphore(device);
     data.renderedFence = vkn::CreateFence(device, VK_TRUE);
     return data;
@@ -23,6 +41,26 @@ FrameData CreateFrameData(VkDevice device, VkCommandPool commandPool)
 
 std::vector<VkSemaphore> renderingFinished;
 
+// a replaced swapchain and the semaphores its last presents wait on. frame fences don't cover vkQueuePresentKHR, so both are kept
+// until the new swapchain has presented each of its images once, by then the presentation engine is done with the old ones
+struct RetiredSwapchain
+{
+    vkn::Swapchain swapchain;
+    std::vector<VkSemaphore> renderingFinished;
+    uint32_t presentsLeft = 0;
+};
+
+std::vector<RetiredSwapchain> retiredSwapchains;
+
+void DestroyRetiredSwapchain(VkDevice device, RetiredSwapchain& retired)
+{
+    vkn::DestroySwapchain(device, retired.swapchain);
+    for(VkSemaphore semaphore : retired.renderingFinished)
+    {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+}
+
 struct UniformBufferData
 {
     glm::mat4 model = glm::mat4(1.f), view = glm::mat4(1.f), projection = glm::mat4(1.f);
@@ -38,6 +76,14 @@ struct Camera
     float sensitivity = 0.5f;
 };
 
+void UpdateUniformBufferData(const Camera& camera, UniformBufferData& uniformBufferData, VkExtent2D extent)
+{
+    uniformBufferData.model = glm::mat4(1.f);
+    uniformBufferData.view = glm::lookAt(camera.position, camera.position + camera.front, camera.up);
+    uniformBufferData.projection = glm::perspective(glm::radians(90.f), float(extent.width) / float(extent.height), 0.01f, 100.f);
+    uniformBufferData.projection[1][1] *= -1.f;
+}
+
 void ProcessCameraInput(Window& window, Camera& camera, UniformBufferData& uniformBufferData, VkExtent2D extent)
 {
 
@@ -91,23 +137,296 @@ void ProcessCameraInput(Window& window, Camera& camera, UniformBufferData& unifo
         glfwSetInputMode(window.GetNativeWindow(), GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
 
+    UpdateUniformBufferData(camera, uniformBufferData, extent);
+}
 
-    uniformBufferData.model = glm::mat4(1.f);
-    uniformBufferData.view = glm::lookAt(camera.position, camera.position + camera.front, camera.up);
-    uniformBufferData.projection = glm::perspective(glm::radians(90.f), float(extent.width) / float(extent.height), 0.01f, 100.f);
-    uniformBufferData.projection[1][1] *= -1.f;
+// fixed orbit around the scene so every headless run renders the same frames
+void ProcessHeadlessCamera(uint32_t frameIndex, Camera& camera, UniformBufferData& uniformBufferData, VkExtent2D extent)
+{
+    glm::vec3 center = glm::vec3(4.5f, 0.f, 4.5f);
+    float angle = frameIndex * 0.01f;
+
+    camera.position = center + glm::vec3(glm::sin(angle) * 8.f, 5.f, glm::cos(angle) * 8.f);
+    camera.front = glm::normalize(center - camera.position);
+
+    UpdateUniformBufferData(camera, uniformBufferData, extent);
+}
+
+// gribb hartmann planes of projection * view with inward normals, near is z = 0 as vulkan clips depth to [0, 1]
+void BuildCullView(const UniformBufferData& uniformBufferData, vkn::CullView& cullView)
+{
+    glm::mat4 viewProjection = uniformBufferData.projection * uniformBufferData.view;
+    memcpy(cullView.viewProjection, &viewProjection, sizeof(cullView.viewProjection));
+
+    auto row = [&viewProjection](int i) { return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+    glm::vec4 row0 = row(0), row1 = row(1), row2 = row(2), row3 = row(3);
 
+    glm::vec4 frustum[6] = {row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2};
+    for(int i = 0; i < 6; i++)
+    {
+        glm::vec4 plane = frustum[i] / glm::length(glm::vec3(frustum[i]));
+        cullView.frustumPlanes[i][0] = plane.x;
+        cullView.frustumPlanes[i][1] = plane.y;
+        cullView.frustumPlanes[i][2] = plane.z;
+        cullView.frustumPlanes[i][3] = plane.w;
+    }
 }
 
+void WriteHeadlessTimings(const std::vector<double>& cpuFrameMs, const std::vector<double>& gpuFrameMs)
+{
+    std::ofstream file(HEADLESS_TIMINGS_FILENAME);
+    file << "frame,cpu_ms,gpu_ms\n";
+    for(size_t i = 0; i < cpuFrameMs.size(); i++)
+    {
+        file << std::format("{},{:.4f},{:.4f}\n", i, cpuFrameMs[i], gpuFrameMs[i]);
+    }
+
+    auto printSummary = [](const char* name, std::vector<double> values)
+    {
+        if(values.empty())
+            return;
+
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for(double value : values)
+        {
+            sum += value;
+        }
+
+        std::println("{} ms: avg {:.3f}, p50 {:.3f}, p95 {:.3f}, max {:.3f}", name, sum / values.size(),
+            values[values.size() / 2], values[std::min(values.size() - 1, values.size() * 95 / 100)], values.back());
+    };
+
+    std::println("headless: {} frames, timings written to {}", cpuFrameMs.size(), HEADLESS_TIMINGS_FILENAME);
+    printSummary("cpu", cpuFrameMs);
+    printSummary("gpu", gpuFrameMs);
+}
+
+// block faces in the order shader.vert looks up their normals
+enum class BlockFace : uint32_t
+{
+    Front,  // +z
+    Back,   // -z
+    Left,   // -x
+    Right,  // +x
+    Bottom, // -y
+    Top     // +y
+};
+
+// 8 bytes of block geometry, decoded in shader.vert.
+// low word: x, y and z at bits 0, 6 and 12 (6 bits each), face at 18 (3 bits), corner at 21 (2 bits), ao at 23 (2 bits).
+// high word: texture layer in the low 16 bits, added to the instance's layer.
+// positions are block corners in chunk local units, 0 to 32 inclusive, blocks are centered on integer coordinates so the shader subtracts 0.5.
+// the corner picks the uv, (0,0) (1,0) (1,1) (0,1) going around the face, and ao darkens the vertex by a fifth per step
 struct Vertex
 {
-    glm::vec3 position = glm::vec3(0);
-    glm::vec3 normal = glm::vec3(0);
-    glm::vec2 uv = glm::vec2(0);
+    uint32_t packed = 0;
+    uint32_t layer = 0;
 };
+static_assert(sizeof(Vertex) == 8);
 
+Vertex PackVertex(uint32_t x, uint32_t y, uint32_t z, BlockFace face, uint32_t corner, uint32_t ao = 0, uint32_t layer = 0)
+{
+    Vertex vertex;
+    vertex.packed = (x & 63u) | (y & 63u) << 6 | (z & 63u) << 12 | (uint32_t(face) & 7u) << 18 | (corner & 3u) << 21 | (ao & 3u) << 23;
+    vertex.layer = layer & 0xffffu;
+    return vertex;
+}
 
-Game::Game()
+struct InstanceData
+{
+    glm::mat4 model = glm::mat4(1.f);
+    // texture array in the descriptor heap, its sampler and the layer in the array
+    uint32_t textureIndex = 0;
+    uint32_t samplerIndex = 0;
+    uint32_t layer = 0;
+};
+
+
+// spir-v straight out of the mapped archive when it is packed there uncompressed, otherwise decompressed or read from the loose file on a job
+struct ShaderCode
+{
+    std::span<const uint32_t> packed;
+    std::future<std::vector<uint32_t>> pending;
+    std::vector<uint32_t> read;
+
+    // waits for the read when there is one
+    std::span<const uint32_t> Get()
+    {
+        if(pending.valid())
+            read = pending.get();
+        return packed.empty() ? std::span<const uint32_t>(read) : packed;
+    }
+};
+
+struct SceneData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<InstanceData> models;
+};
+
+// runs on a job before the texture array is uploaded, so instances only get their layer and the material indices are filled in afterwards
+SceneData BuildScene(uint32_t floorLayer, uint32_t wallLayer)
+{
+    SceneData scene;
+
+    scene.vertices = 
+    {
+        PackVertex(0, 0, 1, BlockFace::Front, 0),
+        PackVertex(1, 0, 1, BlockFace::Front, 1),
+        PackVertex(1, 1, 1, BlockFace::Front, 2),
+        PackVertex(0, 1, 1, BlockFace::Front, 3),
+
+        PackVertex(1, 0, 0, BlockFace::Back, 0),
+        PackVertex(0, 0, 0, BlockFace::Back, 1),
+        PackVertex(0, 1, 0, BlockFace::Back, 2),
+        PackVertex(1, 1, 0, BlockFace::Back, 3),
+
+        PackVertex(0, 0, 0, BlockFace::Left, 0),
+        PackVertex(0, 0, 1, BlockFace::Left, 1),
+        PackVertex(0, 1, 1, BlockFace::Left, 2),
+        PackVertex(0, 1, 0, BlockFace::Left, 3),
+
+        PackVertex(1, 0, 1, BlockFace::Right, 0),
+        PackVertex(1, 0, 0, BlockFace::Right, 1),
+        PackVertex(1, 1, 0, BlockFace::Right, 2),
+        PackVertex(1, 1, 1, BlockFace::Right, 3),
+
+        PackVertex(0, 0, 0, BlockFace::Bottom, 0),
+        PackVertex(1, 0, 0, BlockFace::Bottom, 1),
+        PackVertex(1, 0, 1, BlockFace::Bottom, 2),
+        PackVertex(0, 0, 1, BlockFace::Bottom, 3),
+
+        PackVertex(0, 1, 1, BlockFace::Top, 0),
+        PackVertex(1, 1, 1, BlockFace::Top, 1),
+        PackVertex(1, 1, 0, BlockFace::Top, 2),
+        PackVertex(0, 1, 0, BlockFace::Top, 3),
+    };
+
+    scene.indices = 
+    {
+        0,  1,  2,  2,  3,  0,       // Front
+        4,  5,  6,  6,  7,  4,      // Back
+        8,  9, 10, 10, 11,  8,      // Left
+        12, 13, 14, 14, 15, 12,      // Right
+        16, 17, 18, 18, 19, 16,      // Bottom
+        20, 21, 22, 22, 23, 20       // Top
+    };
+
+    int side = 10;
+    int x = 0, z = 0;
+    for(int i = 0; i < side * side; i++)
+    {
+        glm::mat4 model = glm::mat4(1.f);
+        model = glm::translate(model, glm::vec3(x, 0, z));
+        scene.models.push_back({model, 0, 0, floorLayer});
+
+        x++;
+        if(x >= 10)
+        {
+            x = 0;
+            z++;
+        }
+    }
+
+    for(int i = 0; i < 9; i++)
+    {
+        glm::mat4 model = glm::mat4(1.f);
+        model = glm::translate(model, glm::vec3(i + 1, 1, 0));
+        scene.models.push_back({model, 0, 0, wallLayer});
+        model = glm::mat4(1.f);
+        model = glm::translate(model, glm::vec3(i + 1, 2, 0));
+        scene.models.push_back({model, 0, 0, wallLayer});
+    }
+
+
+    for(int i = 0; i < 9; i++)
+    {
+        glm::mat4 model = glm::mat4(1.f);
+        model = glm::translate(model, glm::vec3(9, 1, i + 1));
+        scene.models.push_back({model, 0, 0, wallLayer});
+        model = glm::mat4(1.f);
+        model = glm::translate(model, glm::vec3(9, 2, i + 1));
+        scene.models.push_back({model, 0, 0, wallLayer});
+    }
+
+    return scene;
+}
+
+// stage spans from the start of Initialize to the first frame, recorded from any thread and printed once that frame went out.
+// stages recorded more than once, like jobs, are merged into their first start, last end and summed busy time
+class StartupTimeline
+{
+public:
+    StartupTimeline() : mStartUs(Profiler::NowUs()) {}
+
+    void Record(const char* name, double beginUs, double endUs, double busyUs, uint32_t jobCount = 1)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(Stage& stage : mStages)
+        {
+            if(strcmp(stage.name, name) == 0)
+            {
+                stage.beginUs = std::min(stage.beginUs, beginUs);
+                stage.endUs = std::max(stage.endUs, endUs);
+                stage.busyUs += busyUs;
+                stage.jobCount += jobCount;
+                return;
+            }
+        }
+        mStages.push_back({name, beginUs, endUs, busyUs, jobCount});
+    }
+
+    // ends now
+    void Record(const char* name, double beginUs)
+    {
+        double endUs = Profiler::NowUs();
+        Record(name, beginUs, endUs, endUs - beginUs);
+    }
+
+    void Print()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::sort(mStages.begin(), mStages.end(), [](const Stage& a, const Stage& b) { return a.beginUs < b.beginUs; });
+
+        for(const Stage& stage : mStages)
+        {
+            std::println("startup: {:<16} {:8.1f} -> {:8.1f} ms, busy {:8.1f} ms in {} job(s)", stage.name, (stage.beginUs - mStartUs) / 1000.0,
+                (stage.endUs - mStartUs) / 1000.0, stage.busyUs / 1000.0, stage.jobCount);
+        }
+        std::println("startup: first frame after {:.1f} ms", (Profiler::NowUs() - mStartUs) / 1000.0);
+    }
+
+private:
+    struct Stage
+    {
+        const char* name;
+        double beginUs;
+        double endUs;
+        double busyUs;
+        uint32_t jobCount;
+    };
+
+    double mStartUs;
+    std::mutex mMutex;
+    std::vector<Stage> mStages;
+};
+
+vkn::RenderQuality GetRenderQuality(QualityTier tier)
+{
+    vkn::RenderQuality quality;
+    switch(tier)
+    {
+        case QualityTier::Low: quality.samples = VK_SAMPLE_COUNT_1_BIT; quality.renderScale = 0.75f; break;
+        case QualityTier::Medium: quality.samples = VK_SAMPLE_COUNT_2_BIT; quality.renderScale = 1.f; break;
+        case QualityTier::High: quality.samples = VK_SAMPLE_COUNT_4_BIT; quality.renderScale = 1.f; break;
+        case QualityTier::Ultra: quality.samples = VK_SAMPLE_COUNT_8_BIT; quality.renderScale = 1.f; break;
+    }
+    return quality;
+}
+
+Game::Game(const GameOptions& options) : mOptions(options)
 {
 }
 
@@ -118,108 +437,136 @@ Game::~Game()
 void Game::Run()
 {
     Initialize();
+    Terminate();
 }
 void Game::Initialize() 
 {
-    mWindow.CreateWindow(800, 600, "minevulkan");
-
-            
-    std::vector<Vertex> vertices = 
-    {
-        // ===== Front (+Z) =====
-        {{-0.5f, -0.5f,  0.5f}, {0, 0, 1}, {0, 0}},
-        {{ 0.5f, -0.5f,  0.5f}, {0, 0, 1}, {1, 0}},
-        {{ 0.5f,  0.5f,  0.5f}, {0, 0, 1}, {1, 1}},
-        {{-0.5f,  0.5f,  0.5f}, {0, 0, 1}, {0, 1}},
-
-        // ===== Back (-Z) =====
-        {{ 0.5f, -0.5f, -0.5f}, {0, 0,-1}, {0, 0}},
-        {{-0.5f, -0.5f, -0.5f}, {0, 0,-1}, {1, 0}},
-        {{-0.5f,  0.5f, -0.5f}, {0, 0,-1}, {1, 1}},
-        {{ 0.5f,  0.5f, -0.5f}, {0, 0,-1}, {0, 1}},
-
-        // ===== Left (-X) =====
-        {{-0.5f, -0.5f, -0.5f}, {-1, 0, 0}, {0, 0}},
-        {{-0.5f, -0.5f,  0.5f}, {-1, 0, 0}, {1, 0}},
-        {{-0.5f,  0.5f,  0.5f}, {-1, 0, 0}, {1, 1}},
-        {{-0.5f,  0.5f, -0.5f}, {-1, 0, 0}, {0, 1}},
-
-        // ===== Right (+X) =====
-        {{ 0.5f, -0.5f,  0.5f}, {1, 0, 0}, {0, 0}},
-        {{ 0.5f, -0.5f, -0.5f}, {1, 0, 0}, {1, 0}},
-        {{ 0.5f,  0.5f, -0.5f}, {1, 0, 0}, {1, 1}},
-        {{ 0.5f,  0.5f,  0.5f}, {1, 0, 0}, {0, 1}},
-
-        // ===== Bottom (-Y) =====
-        {{-0.5f, -0.5f, -0.5f}, {0,-1, 0}, {0, 0}},
-        {{ 0.5f, -0.5f, -0.5f}, {0,-1, 0}, {1, 0}},
-        {{ 0.5f, -0.5f,  0.5f}, {0,-1, 0}, {1, 1}},
-        {{-0.5f, -0.5f,  0.5f}, {0,-1, 0}, {0, 1}},
-
-        // ===== Top (+Y) =====
-        {{-0.5f,  0.5f,  0.5f}, {0, 1, 0}, {0, 0}},
-        {{ 0.5f,  0.5f,  0.5f}, {0, 1, 0}, {1, 0}},
-        {{ 0.5f,  0.5f, -0.5f}, {0, 1, 0}, {1, 1}},
-        {{-0.5f,  0.5f, -0.5f}, {0, 1, 0}, {0, 1}},
-    };
+    StartupTimeline startup;
+
+    // file reads, decoding and mesh generation don't need the device, they run on the pool while the window and context are created
+    JobPool jobPool;
+    jobPool.Create();
 
-    std::vector<uint32_t> indices = 
+    // Assets.pak once the assets target built it, loose files otherwise
+    AssetArchive assets;
+    double archiveBeginUs = Profiler::NowUs();
+    if(assets.Open(ASSET_ARCHIVE_FILENAME))
+        std::println("assets: {} entries mapped from {}", assets.GetEntries().size(), ASSET_ARCHIVE_FILENAME);
+    startup.Record("archive open", archiveBeginUs);
+
+    auto loadShader = [&startup, &assets, &jobPool](const char* filename)
     {
-        0,  1,  2,  2,  3,  0,       // Front
-        4,  5,  6,  6,  7,  4,      // Back
-        8,  9, 10, 10, 11,  8,      // Left
-        12, 13, 14, 14, 15, 12,      // Right
-        16, 17, 18, 18, 19, 16,      // Bottom
-        20, 21, 22, 22, 23, 20       // Top
+        ShaderCode code;
+        const AssetArchiveEntry* entry = assets.Find(filename);
+        if(entry != nullptr && entry->compression == AssetCompression::None && entry->size % sizeof(uint32_t) == 0)
+        {
+            std::span<const uint8_t> packed = assets.GetData(*entry);
+            code.packed = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(packed.data()), packed.size() / sizeof(uint32_t));
+            return code;
+        }
+
+        // compressed entries are inflated on the job, only names the archive doesn't have fall back to the loose file
+        code.pending = jobPool.Submit([&startup, &assets, entry, filename]()
+        {
+            double beginUs = Profiler::NowUs();
+            std::vector<uint32_t> words;
+            if(entry == nullptr)
+            {
+                words = vkn::ReadShaderFile(filename);
+                startup.Record("shader read", beginUs);
+                return words;
+            }
+
+            words.resize(entry->size / sizeof(uint32_t));
+            std::span<uint8_t> bytes(reinterpret_cast<uint8_t*>(words.data()), words.size() * sizeof(uint32_t));
+            if(entry->size % sizeof(uint32_t) != 0 || !assets.Read(*entry, bytes))
+            {
+                std::println("Failed to read shader {} from {}", filename, assets.GetPath());
+                words.clear();
+            }
+            startup.Record("shader decompress", beginUs);
+            return words;
+        });
+        return code;
     };
+    ShaderCode vertexShaderCode = loadShader("Shaders/shader.vert.spv");
+    ShaderCode fragmentShaderCode = loadShader("Shaders/shader.frag.spv");
+
+    vkn::TextureArray blockTextures;
+    double listBeginUs = Profiler::NowUs();
+    // bc1 from the cache when the device can sample it, TextureCache/ is filled on first run or by the texturecache tool
+    blockTextures.Load(jobPool, "Textures/Kenney-Prototype-Textures", "TextureCache/Kenney-Prototype-Textures", &assets);
+    startup.Record("texture listing", listBeginUs);
+
+    uint32_t floorLayer = blockTextures.GetLayer("Dark/texture_13");
+    uint32_t wallLayer = blockTextures.GetLayer("Orange/texture_01");
+    std::future<SceneData> sceneData = jobPool.Submit([&startup, floorLayer, wallLayer]()
+    {
+        double beginUs = Profiler::NowUs();
+        SceneData scene = BuildScene(floorLayer, wallLayer);
+        startup.Record("mesh generation", beginUs);
+        return scene;
+    });
 
+    double windowBeginUs = Profiler::NowUs();
+    if(!mOptions.headless)
+        mWindow.CreateWindow(800, 600, "minevulkan");
+    startup.Record("window", windowBeginUs);
 
-    mVulkanContext = vkn::CreateVulkanContext(mWindow.GetNativeWindow());
+    double contextBeginUs = Profiler::NowUs();
+    mVulkanContext = vkn::CreateVulkanContext(mOptions.headless ? nullptr : mWindow.GetNativeWindow(), {mOptions.width, mOptions.height}, GetRenderQuality(mOptions.quality));
+    startup.Record("vulkan context", contextBeginUs);
 
-    VkDescriptorSetLayoutBinding uniformBinding = vkn::CreateSetLayoutBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
-    VkDescriptorSetLayoutBinding samplerBinding = vkn::CreateSetLayoutBinding(1, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkDescriptorSetLayoutBinding uniformBinding = vkn::CreateSetLayoutBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT);
 
     VkDescriptorSetLayout uniformSetLayout = vkn::CreateDescriptorSetLayout(mVulkanContext.device, {uniformBinding});
-    VkDescriptorSetLayout samplerSetLayout = vkn::CreateDescriptorSetLayout(mVulkanContext.device, {samplerBinding});
 
 
-    VkPipelineLayout pipelineLayout = vkn::CreatePipelineLayout(mVulkanContext.device, {uniformSetLayout, samplerSetLayout});
+    VkPipelineLayout pipelineLayout = vkn::CreatePipelineLayout(mVulkanContext.device, {uniformSetLayout, mVulkanContext.descriptorHeap->GetSetLayout()});
 
-    VkShaderModule vertexShaderModule = vkn::CreateShaderModuleFromFile(mVulkanContext.device, "Shaders/shader.vert.spv");
-    VkShaderModule fragmentShaderModule = vkn::CreateShaderModuleFromFile(mVulkanContext.device, "Shaders/shader.frag.spv");
-
-    VkViewport viewport = {};
-    viewport.width = mVulkanContext.swapchain.extent.width;
-    viewport.height = mVulkanContext.swapchain.extent.height;
-    viewport.maxDepth = 1.f;
+    vkn::ResourceHandle vertexShader = mVulkanContext.resourceCache->LoadShaderModule("Shaders/shader.vert.spv", vertexShaderCode.Get());
+    vkn::ResourceHandle fragmentShader = mVulkanContext.resourceCache->LoadShaderModule("Shaders/shader.frag.spv", fragmentShaderCode.Get());
+    if(vertexShader == UINT32_MAX || fragmentShader == UINT32_MAX)
+    {
+        std::println("Shaders/shader.vert.spv or Shaders/shader.frag.spv is missing or invalid, build the shaders target");
+        std::abort();
+    }
 
     VkVertexInputBindingDescription bindingDescription = vkn::CreateBindingDescription(0, VK_VERTEX_INPUT_RATE_VERTEX, sizeof(Vertex));
-    VkVertexInputBindingDescription instanceBindingDescription = vkn::CreateBindingDescription(1, VK_VERTEX_INPUT_RATE_INSTANCE, sizeof(glm::mat4));
+    VkVertexInputBindingDescription instanceBindingDescription = vkn::CreateBindingDescription(1, VK_VERTEX_INPUT_RATE_INSTANCE, sizeof(InstanceData));
 
-    VkVertexInputAttributeDescription positionAttributeDescription = vkn::CreateAttributeDescription(0, 0, offsetof(Vertex, position), VK_FORMAT_R32G32B32_SFLOAT);
-    VkVertexInputAttributeDescription normalAttributeDescription = vkn::CreateAttributeDescription(0, 1, offsetof(Vertex, normal), VK_FORMAT_R32G32B32_SFLOAT);
-    VkVertexInputAttributeDescription uvAttributeDescription = vkn::CreateAttributeDescription(0, 2, offsetof(Vertex, uv), VK_FORMAT_R32G32_SFLOAT);
+    // both words of the packed vertex as one uvec2, the shader unpacks the fields
+    VkVertexInputAttributeDescription packedAttributeDescription = vkn::CreateAttributeDescription(0, 0, offsetof(Vertex, packed), VK_FORMAT_R32G32_UINT);
 
     VkVertexInputAttributeDescription instanceAttributeDescription0 = vkn::CreateAttributeDescription(1, 3, sizeof(glm::vec4) * 0, VK_FORMAT_R32G32B32A32_SFLOAT);
     VkVertexInputAttributeDescription instanceAttributeDescription1 = vkn::CreateAttributeDescription(1, 4, sizeof(glm::vec4) * 1, VK_FORMAT_R32G32B32A32_SFLOAT);
     VkVertexInputAttributeDescription instanceAttributeDescription2 = vkn::CreateAttributeDescription(1, 5, sizeof(glm::vec4) * 2, VK_FORMAT_R32G32B32A32_SFLOAT);
     VkVertexInputAttributeDescription instanceAttributeDescription3 = vkn::CreateAttributeDescription(1, 6, sizeof(glm::vec4) * 3, VK_FORMAT_R32G32B32A32_SFLOAT);
+    VkVertexInputAttributeDescription instanceMaterialDescription = vkn::CreateAttributeDescription(1, 7, offsetof(InstanceData, textureIndex), VK_FORMAT_R32G32B32_UINT);
 
+    vkn::GraphicsPipelineDescription blockPipelineDescription;
+    blockPipelineDescription.layout = pipelineLayout;
+    blockPipelineDescription.renderPass = mVulkanContext.renderPass;
+    blockPipelineDescription.vertexShaderModule = mVulkanContext.resourceCache->GetShaderModule(vertexShader);
+    blockPipelineDescription.fragmentShaderModule = mVulkanContext.resourceCache->GetShaderModule(fragmentShader);
+    blockPipelineDescription.vertexBindings = {bindingDescription, instanceBindingDescription};
+    blockPipelineDescription.vertexAttributes = {packedAttributeDescription, instanceAttributeDescription0, instanceAttributeDescription1, instanceAttributeDescription2, instanceAttributeDescription3, instanceMaterialDescription};
+    blockPipelineDescription.samples = mVulkanContext.quality.samples;
 
-    VkPipeline graphicPipeline = vkn::CreateGraphicsPipeline(mVulkanContext.device, pipelineLayout, mVulkanContext.renderPass, vertexShaderModule, fragmentShaderModule, viewport, {bindingDescription, instanceBindingDescription}, {positionAttributeDescription, normalAttributeDescription, uvAttributeDescription, instanceAttributeDescription0, instanceAttributeDescription1, instanceAttributeDescription2, instanceAttributeDescription3});
+    vkn::PipelineHandle blockPipeline = mVulkanContext.pipelineRegistry->Request(blockPipelineDescription);
 
 
 
-    int maxFrameInFlight = 2;
+    int maxFrameInFlight = MAX_FRAMES_IN_FLIGHT;
     FrameData* frameDatas = new FrameData[maxFrameInFlight];
 
     for(int i = 0; i < maxFrameInFlight; i++)
     {
-        frameDatas[i] = CreateFrameData(mVulkanContext.device, mVulkanContext.commandPool);
+        frameDatas[i] = CreateFrameData(mVulkanContext.device);
     }
 
 
-    for(int i = 0; i < mVulkanContext.swapchain.images.size(); i++)
+    for(int i = 0; i < mVulkanContext.swapchain.images.size() && !mOptions.headless; i++)
     {
         VkSemaphore semaphore = vkn::CreateSemaphore(mVulkanContext.device);
         renderingFinished.push_back(semaphore);
@@ -229,192 +576,472 @@ void Game::Initialize()
 
 
     UniformBufferData uniformBufferData;
-    vkn::Buffer uniformBuffer = vkn::CreateBuffer(mVulkanContext.physicalDevice, mVulkanContext.device, sizeof(uniformBufferData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-   
+    vkn::UniformRing uniformRing;
+    uniformRing.Create(mVulkanContext.allocator, 64 * 1024, maxFrameInFlight);
 
-    VkDescriptorPoolSize poolSize = vkn::CreatePoolSize(maxFrameInFlight, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-    VkDescriptorPoolSize samplerPoolSize = vkn::CreatePoolSize(maxFrameInFlight, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
+    VkDescriptorPoolSize poolSize = vkn::CreatePoolSize(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 
-    VkDescriptorPool descriptorPool = vkn::CreateDescriptorPool(mVulkanContext.device, {poolSize, samplerPoolSize}, maxFrameInFlight * 2);
 
-    VkDescriptorSet *descriptorSet = new VkDescriptorSet[maxFrameInFlight];
-    VkDescriptorSet *samplerDescriptorSet = new VkDescriptorSet[maxFrameInFlight];
+    VkDescriptorPool descriptorPool = vkn::CreateDescriptorPool(mVulkanContext.device, {poolSize}, 1);
 
-    for(int i = 0; i < maxFrameInFlight; i++)
-    {
-        descriptorSet[i] = vkn::AllocateDescriptorSet(mVulkanContext.device, descriptorPool, {uniformSetLayout});
-        samplerDescriptorSet[i] = vkn::AllocateDescriptorSet(mVulkanContext.device, descriptorPool, {samplerSetLayout});
-    }
+    VkDescriptorSet descriptorSet = vkn::AllocateDescriptorSet(mVulkanContext.device, descriptorPool, {uniformSetLayout});
+
+    vkn::UpdateDynamicUniformBufferDescriptorSet(mVulkanContext.device, descriptorSet, uniformRing.GetBuffer(), sizeof(UniformBufferData));
 
     Camera camera;
 
+    // the one sync point, everything the jobs made is staged here and the first frame's flush copies it
+    double uploadBeginUs = Profiler::NowUs();
+    SceneData scene = sceneData.get();
+    blockTextures.Create(mVulkanContext);
+    vkn::TextureArrayStats textureStats = blockTextures.GetStats();
+    // the cache owns the array from here on and retires it on the last Release
+    vkn::ResourceHandle blockTextureArray = mVulkanContext.resourceCache->AddTextureArray("Textures/Kenney-Prototype-Textures", std::move(blockTextures));
+    vkn::ResourceHandle blockSampler = mVulkanContext.resourceCache->LoadSampler();
+
+    uint32_t textureIndex = mVulkanContext.resourceCache->GetTextureIndex(blockTextureArray);
+    uint32_t sampler = mVulkanContext.descriptorHeap->RegisterSampler(mVulkanContext.resourceCache->GetSampler(blockSampler));
+    for(InstanceData& instance : scene.models)
+    {
+        instance.textureIndex = textureIndex;
+        instance.samplerIndex = sampler;
+    }
+
     vkn::VertexBuffer vertexBuffer(mVulkanContext);
-    vertexBuffer.Create(sizeof(Vertex) * vertices.size());
-    vertexBuffer.SetData(sizeof(Vertex) * vertices.size(), vertices.data());
+    vertexBuffer.Create(sizeof(Vertex) * scene.vertices.size());
+    vertexBuffer.SetData(sizeof(Vertex) * scene.vertices.size(), scene.vertices.data());
     
     vkn::IndexBuffer indexBuffer(mVulkanContext);
-    indexBuffer.Create(sizeof(uint32_t) * indices.size());
-    indexBuffer.SetData(sizeof(uint32_t) * indices.size(), indices.data());
+    indexBuffer.Create(sizeof(uint32_t) * scene.indices.size());
+    indexBuffer.SetData(sizeof(uint32_t) * scene.indices.size(), scene.indices.data());
 
+    vkn::VertexBuffer instanceVertexBuffer(mVulkanContext);
+    instanceVertexBuffer.Create(sizeof(InstanceData) * scene.models.size());
+    instanceVertexBuffer.SetData(sizeof(InstanceData) * scene.models.size(), scene.models.data());
+    startup.Record("upload", uploadBeginUs);
 
-    vkn::Texture texture;
-    texture.CreateFromFile(mVulkanContext, "Textures/Kenney-Prototype-Textures/Dark/texture_13.png");
+    if(textureStats.layers > 0)
+        startup.Record("texture decode", textureStats.loadBeginUs, textureStats.loadEndUs, textureStats.loadBusyUs, textureStats.layers);
 
-    std::vector<glm::mat4> models;
-    
-    int side = 10;
-    int x = 0, z = 0;
-    for(int i = 0; i < side * side; i++)
-    {
-        glm::mat4 model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(x, 0, z));
-        models.push_back(model);
+    // nothing is loaded after startup, the spans into the archive aren't used past this point
+    jobPool.Destroy();
+    assets.Close();
 
-        x++;
-        if(x >= 10)
-        {
-            x = 0;
-            z++;
-        }
-    }
-
-    for(int i = 0; i < 9; i++)
+    // every instance is a unit cube, bounded by the sphere through its corners
+    std::vector<vkn::IndirectObject> cullObjects;
+    for(const InstanceData& instance : scene.models)
     {
-        glm::mat4 model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(i + 1, 1, 0));
-        models.push_back(model);
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(i + 1, 2, 0));
-        models.push_back(model);
+        vkn::IndirectObject object;
+        object.center[0] = instance.model[3].x;
+        object.center[1] = instance.model[3].y;
+        object.center[2] = instance.model[3].z;
+        object.radius = 0.87f;
+        object.indexCount = scene.indices.size();
+        cullObjects.push_back(object);
     }
 
+    vkn::IndirectCuller culler;
+    culler.Create(mVulkanContext, cullObjects);
 
-    for(int i = 0; i < 9; i++)
-    {
-        glm::mat4 model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(9, 1, i + 1));
-        models.push_back(model);
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(9, 2, i + 1));
-        models.push_back(model);
-    }
+    // occluders only write depth, so no fragment shader and a single sample
+    vkn::GraphicsPipelineDescription occluderPipelineDescription = blockPipelineDescription;
+    occluderPipelineDescription.renderPass = culler.GetOcclusionRenderPass();
+    occluderPipelineDescription.fragmentShaderModule = VK_NULL_HANDLE;
+    occluderPipelineDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+    vkn::PipelineHandle occluderPipeline = mVulkanContext.pipelineRegistry->Request(occluderPipelineDescription);
 
+    mVulkanContext.allocator->PrintStats();
 
+    vkn::RenderGraph renderGraph;
+    renderGraph.Create(mVulkanContext);
 
-    vkn::VertexBuffer instanceVertexBuffer(mVulkanContext);
-    instanceVertexBuffer.Create(sizeof(glm::mat4) * models.size());
-    instanceVertexBuffer.SetData(sizeof(glm::mat4) * models.size(), models.data());
 
+    PROFILE_THREAD("main");
+#if ENABLE_PROFILER
+    bool traceKeyWasPressed = false;
+#endif
+    bool graphKeyWasPressed = false;
+    bool printRenderGraph = true;
+
+    uint32_t frameIndex = 0;
+    std::vector<double> cpuFrameMs, gpuFrameMs;
+    bool swapchainOutOfDate = false;
+    QualityTier qualityTier = mOptions.quality;
 
-    while(mWindow.GetInput().window.close == false)
+    while(mOptions.headless ? frameIndex < mOptions.frameCount : mWindow.GetInput().window.close == false)
     {
-        mWindow.Update();
-        PollEvent();
-        
-        ProcessCameraInput(mWindow, camera, uniformBufferData, mVulkanContext.swapchain.extent);
+        PROFILE_FRAME();
+        PROFILE_SCOPE("frame");
+        double frameBeginUs = Profiler::NowUs();
+
+        if(mOptions.headless)
+        {
+            ProcessHeadlessCamera(frameIndex, camera, uniformBufferData, mVulkanContext.swapchain.extent);
+        }
+        else
+        {
+            mWindow.Update();
+            PollEvent();
+
+#if ENABLE_PROFILER
+            // P dumps the cpu trace collected so far without leaving the loop
+            bool traceKeyPressed = mWindow.GetInput().keyboard.keyP;
+            if(traceKeyPressed && !traceKeyWasPressed)
+                Profiler::WriteChromeTrace(CPU_TRACE_FILENAME);
+            traceKeyWasPressed = traceKeyPressed;
+#endif
+
+            // G prints the next compiled render graph
+            bool graphKeyPressed = mWindow.GetInput().keyboard.keyG;
+            if(graphKeyPressed && !graphKeyWasPressed)
+                printRenderGraph = true;
+            graphKeyWasPressed = graphKeyPressed;
+
+            ProcessCameraInput(mWindow, camera, uniformBufferData, mVulkanContext.swapchain.extent);
+
+            // F1 to F4 pick the quality tier live
+            const Input::KeyboardInput& keyboard = mWindow.GetInput().keyboard;
+            QualityTier requestedTier = qualityTier;
+            if(keyboard.keyF1) requestedTier = QualityTier::Low;
+            if(keyboard.keyF2) requestedTier = QualityTier::Medium;
+            if(keyboard.keyF3) requestedTier = QualityTier::High;
+            if(keyboard.keyF4) requestedTier = QualityTier::Ultra;
+
+            if(requestedTier != qualityTier)
+            {
+                qualityTier = requestedTier;
+                vkn::SetRenderQuality(mVulkanContext, GetRenderQuality(qualityTier));
+                renderGraph.ReleaseFramebuffers();
+
+                // pipelines for tiers seen before are still in the registry, only new sample counts compile
+                blockPipelineDescription.renderPass = mVulkanContext.renderPass;
+                blockPipelineDescription.samples = mVulkanContext.quality.samples;
+                blockPipeline = mVulkanContext.pipelineRegistry->Request(blockPipelineDescription);
+                printRenderGraph = true;
+            }
+        }
 
+        const Input::WindowInput& windowInput = mWindow.GetInput().window;
+
+        // nothing to present into, sleep until the window comes back instead of spinning
+        if(!mOptions.headless && windowInput.minimized)
+        {
+            WaitEvent(0.25);
+            continue;
+        }
+
+        bool extentChanged = windowInput.framebufferSize.x != mVulkanContext.swapchain.extent.width || windowInput.framebufferSize.y != mVulkanContext.swapchain.extent.height;
+        if(!mOptions.headless && ((windowInput.resize && extentChanged) || (swapchainOutOfDate && !windowInput.resizing)))
+        {
+            swapchainOutOfDate = false;
+
+            // frames still in flight keep using the old images and pending presents wait on the old semaphores,
+            // both are retired once the new swapchain has cycled through its images
+            RetiredSwapchain retired;
+            retired.swapchain = mVulkanContext.swapchain;
+            retired.renderingFinished = renderingFinished;
+            mVulkanContext.swapchain = vkn::CreateSwapchain(mVulkanContext.physicalDevice, mVulkanContext.allocator, mVulkanContext.surface, mVulkanContext.renderPass, mWindow.GetNativeWindow(), mVulkanContext.quality, &retired.swapchain);
+            retired.presentsLeft = mVulkanContext.swapchain.images.size();
+            retiredSwapchains.push_back(retired);
+            renderGraph.ReleaseFramebuffers();
+
+            renderingFinished.clear();
+            for(int i = 0; i < mVulkanContext.swapchain.images.size(); i++)
+            {
+                renderingFinished.push_back(vkn::CreateSemaphore(mVulkanContext.device));
+            }
+        }
         
-        if(mWindow.GetInput().window.size.x != mVulkanContext.swapchain.extent.width || mWindow.GetInput().window.size.y != mVulkanContext.swapchain.extent.height)
+        // an out of date swapchain can't be acquired from, wait for the drag to settle before recreating it
+        if(swapchainOutOfDate)
         {
-            vkDeviceWaitIdle(mVulkanContext.device);
-            vkn::DestroySwapchain(mVulkanContext.device, mVulkanContext.swapchain);
-            mVulkanContext.swapchain = vkn::CreateSwapchain(mVulkanContext.physicalDevice, mVulkanContext.device, mVulkanContext.surface, mVulkanContext.renderPass, mWindow.GetNativeWindow());
+            WaitEvent(0.01);
+            continue;
         }
         
         FrameData currentFrameData = frameDatas[currentFrame];
         
-        vkWaitForFences(mVulkanContext.device, 1, &currentFrameData.renderedFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(mVulkanContext.device, 1, &currentFrameData.renderedFence);
+        {
+            PROFILE_SCOPE("wait for frame");
+            mVulkanContext.commandAllocator->BeginFrame(currentFrame, currentFrameData.renderedFence);
+        }
+
+        // offscreen images are owned one per frame in flight, so the frame fence already guards them
+        uint32_t imageIndex = currentFrame;
+        if(!mOptions.headless)
+        {
+            PROFILE_SCOPE("acquire image");
+            VkResult acquireResult = vkAcquireNextImageKHR(mVulkanContext.device, mVulkanContext.swapchain.handle, UINT64_MAX, currentFrameData.imageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+            // the fence is still signaled at this point, so skipping the frame leaves it ready for the retry
+            if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                swapchainOutOfDate = true;
+                continue;
+            }
+            // suboptimal still signals the semaphore, render this one and recreate afterwards
+            if(acquireResult == VK_SUBOPTIMAL_KHR)
+                swapchainOutOfDate = true;
+        }
 
-        memcpy(uniformBuffer.map, &uniformBufferData, sizeof(uniformBufferData));
-        UpdateUniformBufferDescriptorSet(mVulkanContext.device, descriptorSet[currentFrame], uniformBuffer);
+        vkResetFences(mVulkanContext.device, 1, &currentFrameData.renderedFence);
+        mVulkanContext.deletionQueue->BeginFrame();
+        PROFILE_COUNTER("gpu frame ms", mVulkanContext.gpuProfiler->GetLastFrameMs());
 
+        uniformRing.BeginFrame(currentFrame);
+        uint32_t uniformOffset = uniformRing.Push(uniformBufferData);
 
-        VkDescriptorImageInfo imageInfo = {};
-        imageInfo.sampler = texture.GetSampler();
-        imageInfo.imageView = texture.GetImage().imageView;
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkn::CullView cullView;
+        BuildCullView(uniformBufferData, cullView);
+        culler.Resize(mVulkanContext.swapchain.renderExtent);
+        VkSemaphore cullFinished = culler.Cull(currentFrame, cullView);
+        PROFILE_COUNTER("drawn objects", culler.GetLastStats().drawn);
 
-        VkWriteDescriptorSet samplerWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-        samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerWrite.descriptorCount = 1;
-        samplerWrite.pImageInfo = &imageInfo;
-        samplerWrite.dstBinding = 1;
-        samplerWrite.dstSet = samplerDescriptorSet[currentFrame];
-        samplerWrite.dstArrayElement = 0;
-        
-        vkUpdateDescriptorSets(mVulkanContext.device, 1, &samplerWrite, 0, nullptr);
-        
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(mVulkanContext.device, mVulkanContext.swapchain.handle, UINT64_MAX, currentFrameData.imageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
-        
 
-        vkResetCommandBuffer(currentFrameData.commandBuffer, 0);
+        VkCommandBuffer commandBuffer = mVulkanContext.commandAllocator->Allocate();
         VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-        vkBeginCommandBuffer(currentFrameData.commandBuffer, &beginInfo);
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        mVulkanContext.gpuProfiler->BeginFrame(commandBuffer);
+
+        const vkn::Swapchain& swapchain = mVulkanContext.swapchain;
+        bool upscaled = swapchain.quality.renderScale != 1.f;
+
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStageMasks;
+        if(!mOptions.headless)
+        {
+            waitSemaphores.push_back(currentFrameData.imageAcquiredSemaphore);
+            // a scaled frame first touches the swapchain image with the upscale blit
+            waitStageMasks.push_back(upscaled ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        }
+        waitSemaphores.push_back(cullFinished);
+        waitStageMasks.push_back(culler.GetWaitStage());
+        mVulkanContext.gpuProfiler->BeginScope(commandBuffer, "upload acquire");
+        mVulkanContext.uploadManager->Flush(commandBuffer, waitSemaphores, waitStageMasks);
+        mVulkanContext.gpuProfiler->EndScope(commandBuffer);
+
+        VkImageLayout presentLayout = mOptions.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        // the msaa color and depth attachments never leave the main pass, its render pass handles them on its own.
+        // a scaled frame renders into a transient that only lives until the upscale blit
+        renderGraph.Reset();
+        vkn::RenderGraphResource backbuffer = renderGraph.ImportImage("backbuffer", swapchain.images[imageIndex], VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, mOptions.headless ? VK_PIPELINE_STAGE_2_NONE : VkPipelineStageFlags2(waitStageMasks.front()), presentLayout);
+        vkn::RenderGraphResource sceneColor = backbuffer;
 
         VkClearValue clearValues[] = {{ 0.1, 0.1, 0.1, 1.0 }, {1.f, 0.f}};
 
-        VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-        renderPassBeginInfo.renderArea.extent = mVulkanContext.swapchain.extent;
-        renderPassBeginInfo.renderArea.offset = { 0,0 };
-        renderPassBeginInfo.renderPass = mVulkanContext.renderPass;
-        renderPassBeginInfo.framebuffer = mVulkanContext.swapchain.framebuffers[imageIndex];
-        renderPassBeginInfo.pClearValues = clearValues;
-        renderPassBeginInfo.clearValueCount = 2;
+        // occluders, depth pyramid and the late cull, the buffers it fills are outside the graph so nothing would keep it alive
+        renderGraph.AddPass("occlusion", [&](vkn::RenderGraphBuilder& builder)
+        {
+            builder.SetSideEffect();
+        },
+        [&](VkCommandBuffer commandBuffer)
+        {
+            culler.BeginOcclusionPass(commandBuffer, currentFrame);
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVulkanContext.pipelineRegistry->Get(occluderPipeline));
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &uniformOffset);
+
+            VkDeviceSize offsets[] = {0, 0};
+            VkBuffer vertexBuffers[] = {vertexBuffer.GetBuffer().handle, instanceVertexBuffer.GetBuffer().handle};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer.GetBuffer().handle, 0, VK_INDEX_TYPE_UINT32);
+
+            culler.DrawOccluders(commandBuffer, currentFrame);
+            culler.EndOcclusionPass(commandBuffer, currentFrame);
+        });
+
+        renderGraph.AddPass("main pass", [&](vkn::RenderGraphBuilder& builder)
+        {
+            if(upscaled)
+            {
+                vkn::RenderGraphTextureDescription sceneDescription;
+                sceneDescription.width = swapchain.renderExtent.width;
+                sceneDescription.height = swapchain.renderExtent.height;
+                sceneDescription.format = vkn::GetDisplayFormat();
+                sceneDescription.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                sceneColor = builder.CreateTexture("scene", sceneDescription);
+            }
+
+            builder.Write(sceneColor, vkn::RenderGraphUsages::ColorAttachment, upscaled ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : presentLayout);
+        },
+        [&](VkCommandBuffer commandBuffer)
+        {
+            VkFramebuffer framebuffer = VK_NULL_HANDLE;
+            if(upscaled)
+            {
+                VkImageView sceneView = renderGraph.GetImageView(sceneColor);
+                VkImageView resolveAttachments[] = {swapchain.colorImage.imageView, swapchain.depthImage.imageView, sceneView};
+                VkImageView attachments[] = {sceneView, swapchain.depthImage.imageView};
+                bool resolve = swapchain.quality.samples != VK_SAMPLE_COUNT_1_BIT;
+                framebuffer = resolve ? renderGraph.GetFramebuffer(mVulkanContext.renderPass, resolveAttachments, swapchain.renderExtent)
+                    : renderGraph.GetFramebuffer(mVulkanContext.renderPass, attachments, swapchain.renderExtent);
+            }
+            else
+            {
+                framebuffer = swapchain.framebuffers[imageIndex];
+            }
 
-        vkCmdBeginRenderPass(currentFrameData.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+            renderPassBeginInfo.renderArea.extent = mVulkanContext.swapchain.renderExtent;
+            renderPassBeginInfo.renderArea.offset = { 0,0 };
+            renderPassBeginInfo.renderPass = mVulkanContext.renderPass;
+            renderPassBeginInfo.framebuffer = framebuffer;
+            renderPassBeginInfo.pClearValues = clearValues;
+            renderPassBeginInfo.clearValueCount = 2;
 
-        VkViewport viewport = {};
-        viewport.width = mVulkanContext.swapchain.extent.width;
-        viewport.height = mVulkanContext.swapchain.extent.height;
-        viewport.maxDepth = 1.f;
-        VkRect2D scissor = {};
-        scissor.extent = mVulkanContext.swapchain.extent;
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-        vkCmdSetViewport(currentFrameData.commandBuffer, 0, 1, &viewport);
-        vkCmdSetScissor(currentFrameData.commandBuffer, 0, 1, &scissor);
+            VkViewport viewport = {};
+            viewport.width = mVulkanContext.swapchain.renderExtent.width;
+            viewport.height = mVulkanContext.swapchain.renderExtent.height;
+            viewport.maxDepth = 1.f;
+            VkRect2D scissor = {};
+            scissor.extent = mVulkanContext.swapchain.renderExtent;
 
-        vkCmdBindPipeline(currentFrameData.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipeline);
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        VkDescriptorSet des[] = {descriptorSet[currentFrame], samplerDescriptorSet[currentFrame]};
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mVulkanContext.pipelineRegistry->Get(blockPipeline));
 
-        vkCmdBindDescriptorSets(currentFrameData.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, des, 0, nullptr);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &uniformOffset);
+            mVulkanContext.descriptorHeap->Bind(commandBuffer, pipelineLayout, 1);
 
 
-        VkDeviceSize offsets[] = {0, 0};
+            VkDeviceSize offsets[] = {0, 0};
 
-        VkBuffer vertexBuffers[] = {vertexBuffer.GetBuffer().handle, instanceVertexBuffer.GetBuffer().handle};
+            VkBuffer vertexBuffers[] = {vertexBuffer.GetBuffer().handle, instanceVertexBuffer.GetBuffer().handle};
 
-        vkCmdBindVertexBuffers(currentFrameData.commandBuffer, 0, 2, vertexBuffers, offsets);
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
-        vkCmdBindIndexBuffer(currentFrameData.commandBuffer, indexBuffer.GetBuffer().handle, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer.GetBuffer().handle, 0, VK_INDEX_TYPE_UINT32);
 
-        vkCmdDrawIndexed(currentFrameData.commandBuffer, 36, models.size(), 0, 0, 0);
+            culler.Draw(commandBuffer, currentFrame);
 
-        vkCmdEndRenderPass(currentFrameData.commandBuffer);
+            vkCmdEndRenderPass(commandBuffer);
+        });
 
-        vkEndCommandBuffer(currentFrameData.commandBuffer);
+        if(upscaled)
+        {
+            renderGraph.AddPass("upscale", [&](vkn::RenderGraphBuilder& builder)
+            {
+                builder.Read(sceneColor, vkn::RenderGraphUsages::TransferSrc);
+                builder.Write(backbuffer, vkn::RenderGraphUsages::TransferDst);
+            },
+            [&](VkCommandBuffer commandBuffer)
+            {
+                vkn::RecordImageBlit(commandBuffer, renderGraph.GetImage(sceneColor), swapchain.renderExtent, swapchain.images[imageIndex], swapchain.extent);
+            });
+        }
+
+        renderGraph.Compile();
+        if(printRenderGraph)
+        {
+            renderGraph.PrintCompiled();
+            printRenderGraph = false;
+        }
+        renderGraph.Execute(commandBuffer);
+
+        mVulkanContext.gpuProfiler->EndFrame(commandBuffer);
 
-        VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        vkEndCommandBuffer(commandBuffer);
 
-        vkn::ExecuteCommandBuffer(currentFrameData.commandBuffer, mVulkanContext.queues.graphic,  {waitStageMask}, currentFrameData.renderedFence, {currentFrameData.imageAcquiredSemaphore}, {renderingFinished[imageIndex]});
+        std::vector<VkSemaphore> signalSemaphores = {culler.GetLateSemaphore(currentFrame)};
+        if(!mOptions.headless)
+            signalSemaphores.push_back(renderingFinished[imageIndex]);
 
-        VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-        presentInfo.pImageIndices = &imageIndex;
-        presentInfo.pSwapchains = &mVulkanContext.swapchain.handle;
-        presentInfo.swapchainCount = 1;
-        presentInfo.pWaitSemaphores = &renderingFinished[imageIndex];
-        presentInfo.waitSemaphoreCount = 1;
-        VK_CHECK(vkQueuePresentKHR(mVulkanContext.queues.graphic, &presentInfo));
+        {
+            PROFILE_SCOPE("submit");
+            vkn::ExecuteCommandBuffer(commandBuffer, mVulkanContext.queues.graphic, waitStageMasks, currentFrameData.renderedFence, waitSemaphores, signalSemaphores);
+        }
+
+        if(!mOptions.headless)
+        {
+            VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+            presentInfo.pImageIndices = &imageIndex;
+            presentInfo.pSwapchains = &mVulkanContext.swapchain.handle;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pWaitSemaphores = &renderingFinished[imageIndex];
+            presentInfo.waitSemaphoreCount = 1;
+
+            PROFILE_SCOPE("present");
+            VkResult presentResult = vkQueuePresentKHR(mVulkanContext.queues.graphic, &presentInfo);
+            if(presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+                swapchainOutOfDate = true;
+            else if(presentResult != VK_SUCCESS)
+                std::println("vulkan function failed: vkQueuePresentKHR");
+
+            // the deletion queue still holds them back until the frames that rendered into the old images retire
+            VkDevice device = mVulkanContext.device;
+            vkn::DeletionQueue* deletionQueue = mVulkanContext.deletionQueue;
+            std::erase_if(retiredSwapchains, [device, deletionQueue](RetiredSwapchain& retired)
+            {
+                if(--retired.presentsLeft > 0)
+                    return false;
+
+                deletionQueue->Push([device, retired]() mutable { DestroyRetiredSwapchain(device, retired); });
+                return true;
+            });
+        }
+
+        if(frameIndex == 0)
+            startup.Print();
+
+        // gpu times come back a few frames late, so each row pairs this frame's cpu time with the latest resolved gpu frame
+        cpuFrameMs.push_back((Profiler::NowUs() - frameBeginUs) / 1000.0);
+        gpuFrameMs.push_back(mVulkanContext.gpuProfiler->GetLastFrameMs());
 
         currentFrame = (currentFrame + 1) % maxFrameInFlight;
+        frameIndex++;
         
     }
+
+    vkDeviceWaitIdle(mVulkanContext.device);
+    for(RetiredSwapchain& retired : retiredSwapchains)
+    {
+        DestroyRetiredSwapchain(mVulkanContext.device, retired);
+    }
+    retiredSwapchains.clear();
+    renderGraph.Destroy();
+    culler.PrintStats();
+    culler.Destroy();
+    uniformRing.Destroy();
+    mVulkanContext.resourceCache->Release(blockTextureArray);
+    mVulkanContext.resourceCache->Release(blockSampler);
+    mVulkanContext.resourceCache->Release(vertexShader);
+    mVulkanContext.resourceCache->Release(fragmentShader);
+
+    if(mOptions.headless)
+        WriteHeadlessTimings(cpuFrameMs, gpuFrameMs);
 }
 
 void Game::Terminate()
 {
-    
+    vkDeviceWaitIdle(mVulkanContext.device);
+
+    vkn::PipelineRegistryStats pipelineStats = mVulkanContext.pipelineRegistry->GetStats();
+    std::println("pipeline registry: {} requests, {} deduplicated, {} compiled on workers, {} compiled inline", pipelineStats.requests, pipelineStats.deduplicated, pipelineStats.compiledOnWorker, pipelineStats.compiledInline);
+    mVulkanContext.pipelineRegistry->Destroy();
+
+    mVulkanContext.gpuProfiler->PrintAverages();
+    mVulkanContext.gpuProfiler->ExportChromeTrace(GPU_TRACE_FILENAME);
+#if ENABLE_PROFILER
+    Profiler::WriteChromeTrace(CPU_TRACE_FILENAME);
+#endif
+    mVulkanContext.gpuProfiler->Destroy();
+
+    mVulkanContext.resourceCache->PrintStats();
+    mVulkanContext.resourceCache->Destroy();
+
+    mVulkanContext.deletionQueue->Destroy();
+
+    vkn::CommandAllocatorStats commandStats = mVulkanContext.commandAllocator->GetStats();
+    std::println("command allocator: {} allocations, {} reuses, {} pool resets", commandStats.allocations, commandStats.reuses, commandStats.poolResets);
+    mVulkanContext.commandAllocator->Destroy();
+
+    vkn::SavePipelineCache(mVulkanContext.device, mVulkanContext.pipelineCache, PIPELINE_CACHE_FILENAME);
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include <JobPool.hpp>
+#include <Profiler.hpp>
+
+void JobPool::Create(uint32_t workerCount)
+{
+    mStopping = false;
+
+    if(workerCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for(uint32_t i = 0; i < workerCount; i++)
+    {
+        mWorkers.emplace_back(&JobPool::workerLoop, this);
+    }
+}
+
+void JobPool::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mQueueCondition.notify_all();
+
+    for(std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+}
+
+void JobPool::push(std::function<void()>&& job)
+{
+    if(mWorkers.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push_back(std::move(job));
+    }
+    mQueueCondition.notify_one();
+}
+
+void JobPool::workerLoop()
+{
+    PROFILE_THREAD("job worker");
+
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mQueueCondition.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+
+        if(mQueue.empty())
+            return;
+
+        std::function<void()> job = std::move(mQueue.front());
+        mQueue.pop_front();
+        lock.unlock();
+
+        job();
+    }
+}
@@ -1,10 +1,66 @@
 #include "Game.hpp"
 #include "Macros.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <charconv>
+#include <cstring>
 
-int main()
+// the whole argument has to be a number above zero
+static bool ParsePositive(const char* text, uint32_t& value)
 {
-    Game* game = new Game();
+    const char* end = text + strlen(text);
+    uint32_t parsed = 0;
+    auto [next, error] = std::from_chars(text, end, parsed);
+    if(error != std::errc() || next != end || parsed == 0)
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    GameOptions options;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--headless") == 0)
+            options.headless = true;
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            i++;
+            if(!ParsePositive(argv[i], options.frameCount))
+            {
+                std::println("invalid frame count: {}", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+        {
+            if(!ParsePositive(argv[i + 1], options.width) || !ParsePositive(argv[i + 2], options.height))
+            {
+                std::println("invalid size: {} {}", argv[i + 1], argv[i + 2]);
+                return 1;
+            }
+            i += 2;
+        }
+        else if(strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+        {
+            i++;
+            if(strcmp(argv[i], "low") == 0) options.quality = QualityTier::Low;
+            else if(strcmp(argv[i], "medium") == 0) options.quality = QualityTier::Medium;
+            else if(strcmp(argv[i], "high") == 0) options.quality = QualityTier::High;
+            else if(strcmp(argv[i], "ultra") == 0) options.quality = QualityTier::Ultra;
+            else
+            {
+                std::println("unknown quality tier: {}, expected low, medium, high or ultra", argv[i]);
+                return 1;
+            }
+        }
+        else
+            std::println("unknown argument: {}", argv[i]);
+    }
+
+    Game* game = new Game(options);
     game->Run();
     delete game;
 }
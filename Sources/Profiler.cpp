@@ -0,0 +1,154 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <format>
+#include <mutex>
+#include <print>
+#include <vector>
+
+struct ProfileThreadBuffer
+{
+    static const uint64_t sCapacity = 1 << 16;
+
+    ProfileEvent events[sCapacity];
+    std::atomic<uint64_t> written = 0;
+    uint32_t threadId = 0;
+    std::atomic<const char*> threadName = nullptr;
+};
+
+static std::mutex sRegistryMutex;
+static std::vector<ProfileThreadBuffer*> sThreadBuffers;
+
+static ProfileThreadBuffer* GetThreadBuffer()
+{
+    // buffers are never freed so a trace can still be written after its thread exits
+    thread_local ProfileThreadBuffer* sThreadBuffer = nullptr;
+
+    if(sThreadBuffer == nullptr)
+    {
+        sThreadBuffer = new ProfileThreadBuffer();
+
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        sThreadBuffer->threadId = sThreadBuffers.size() + 1;
+        sThreadBuffers.push_back(sThreadBuffer);
+    }
+
+    return sThreadBuffer;
+}
+
+static void Push(const ProfileEvent& event)
+{
+    ProfileThreadBuffer* buffer = GetThreadBuffer();
+
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[index % ProfileThreadBuffer::sCapacity] = event;
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+double Profiler::NowUs()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::RecordZone(const char* name, double startUs, double durationUs)
+{
+    ProfileEvent event;
+    event.name = name;
+    event.startUs = startUs;
+    event.value = durationUs;
+    event.type = ProfileEventType::Zone;
+    Push(event);
+}
+
+void Profiler::RecordCounter(const char* name, double value)
+{
+    ProfileEvent event;
+    event.name = name;
+    event.startUs = NowUs();
+    event.value = value;
+    event.type = ProfileEventType::Counter;
+    Push(event);
+}
+
+void Profiler::MarkFrame()
+{
+    static std::atomic<uint64_t> sFrameIndex = 0;
+
+    ProfileEvent event;
+    event.name = "frame";
+    event.startUs = NowUs();
+    event.value = static_cast<double>(sFrameIndex++);
+    event.type = ProfileEventType::Frame;
+    Push(event);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    GetThreadBuffer()->threadName.store(name, std::memory_order_relaxed);
+}
+
+void Profiler::WriteChromeTrace(const char* filename)
+{
+    std::ofstream file(filename);
+    if(!file.is_open())
+    {
+        std::println("Failed to write {}", filename);
+        return;
+    }
+
+    std::vector<ProfileThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        buffers = sThreadBuffers;
+    }
+
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"minevulkan\"}}";
+
+    size_t eventCount = 0;
+    std::vector<ProfileEvent> events;
+
+    for(ProfileThreadBuffer* buffer : buffers)
+    {
+        const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+        if(threadName != nullptr)
+            file << std::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}", buffer->threadId, threadName);
+
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > ProfileThreadBuffer::sCapacity ? end - ProfileThreadBuffer::sCapacity : 0;
+
+        events.clear();
+        for(uint64_t i = begin; i < end; i++)
+        {
+            events.push_back(buffer->events[i % ProfileThreadBuffer::sCapacity]);
+        }
+
+        // the owning thread may have lapped the ring while we copied, drop whatever it overwrote
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t firstValid = written > ProfileThreadBuffer::sCapacity ? written - ProfileThreadBuffer::sCapacity : 0;
+        size_t skip = firstValid > begin ? std::min<uint64_t>(firstValid - begin, events.size()) : 0;
+
+        for(size_t i = skip; i < events.size(); i++)
+        {
+            const ProfileEvent& event = events[i];
+            switch(event.type)
+            {
+                case ProfileEventType::Zone:
+                    file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", event.name, buffer->threadId, event.startUs, event.value);
+                    break;
+                case ProfileEventType::Counter:
+                    file << std::format(",\n{{\"name\":\"{}\",\"ph\":\"C\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"args\":{{\"value\":{}}}}}", event.name, buffer->threadId, event.startUs, event.value);
+                    break;
+                case ProfileEventType::Frame:
+                    file << std::format(",\n{{\"name\":\"{} {}\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":{},\"ts\":{:.3f}}}", event.name, static_cast<uint64_t>(event.value), buffer->threadId, event.startUs);
+                    break;
+            }
+        }
+
+        eventCount += events.size() - skip;
+    }
+
+    file << "\n]}\n";
+    std::println("profiler: wrote {} events to {}", eventCount, filename);
+}
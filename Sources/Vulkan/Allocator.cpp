@@ -0,0 +1,342 @@
+#include <Vulkan/Allocator.hpp>
+#include <Macros.hpp>
+#include <Align.hpp>
+#include <Profiler.hpp>
+#include <print>
+
+namespace vkn
+{
+    void Allocator::Create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+    {
+        mPhysicalDevice = physicalDevice;
+        mDevice = device;
+        mBlockSize = blockSize;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mMemoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        mBufferImageGranularity = properties.limits.bufferImageGranularity;
+    }
+
+    void Allocator::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for(Block& block : mBlocks)
+        {
+            if(block.memory != VK_NULL_HANDLE)
+                vkFreeMemory(mDevice, block.memory, nullptr);
+        }
+
+        if(mAllocationCount > 0)
+            std::println("allocator destroyed with {} live allocations ({} bytes)", mAllocationCount, mLiveBytes);
+
+        mBlocks.clear();
+        mLiveBytes = 0;
+        mDedicatedBytes = 0;
+        mAllocationCount = 0;
+        mDedicatedCount = 0;
+    }
+
+    VkDeviceSize Allocator::getSizeClass(VkDeviceSize size) const
+    {
+        const VkDeviceSize minClass = 256;
+        const VkDeviceSize pageSize = 64 * 1024;
+
+        if(size <= minClass)
+            return minClass;
+
+        if(size > 1024 * 1024)
+            return AlignUp(size, pageSize);
+
+        // four classes per power of two keeps the rounding waste under 25%
+        VkDeviceSize power = minClass;
+        while(power * 2 <= size)
+            power *= 2;
+
+        return AlignUp(size, power / 4);
+    }
+
+    VkDeviceSize Allocator::getBlockSize(uint32_t memoryTypeIndex) const
+    {
+        uint32_t heapIndex = mMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        VkDeviceSize heapSize = mMemoryProperties.memoryHeaps[heapIndex].size;
+
+        if(heapSize / 8 < mBlockSize)
+            return AlignUp(heapSize / 8, 1024 * 1024);
+
+        return mBlockSize;
+    }
+
+    VkDeviceMemory Allocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** map)
+    {
+        VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocateInfo.allocationSize = size;
+        allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateMemory(mDevice, &allocateInfo, nullptr, &memory));
+
+        *map = nullptr;
+        if(memory != VK_NULL_HANDLE && (mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            vkMapMemory(mDevice, memory, 0, VK_WHOLE_SIZE, 0, map);
+
+        return memory;
+    }
+
+    uint32_t Allocator::createBlock(uint32_t memoryTypeIndex, bool linear)
+    {
+        Block block;
+        block.size = getBlockSize(memoryTypeIndex);
+        block.memoryTypeIndex = memoryTypeIndex;
+        block.linear = linear;
+        block.memory = allocateMemory(block.size, memoryTypeIndex, &block.map);
+
+        if(block.memory == VK_NULL_HANDLE)
+            return UINT32_MAX;
+
+        block.freeRanges[0] = block.size;
+
+        for(uint32_t i = 0; i < mBlocks.size(); i++)
+        {
+            if(mBlocks[i].memory == VK_NULL_HANDLE)
+            {
+                mBlocks[i] = std::move(block);
+                return i;
+            }
+        }
+
+        mBlocks.push_back(std::move(block));
+        return mBlocks.size() - 1;
+    }
+
+    void Allocator::releaseBlock(uint32_t blockIndex)
+    {
+        Block& block = mBlocks[blockIndex];
+
+        // keep one empty block per memory type around so a free/alloc pair does not hit the driver
+        for(uint32_t i = 0; i < mBlocks.size(); i++)
+        {
+            const Block& other = mBlocks[i];
+            if(i != blockIndex && other.memory != VK_NULL_HANDLE && other.allocationCount == 0 && other.memoryTypeIndex == block.memoryTypeIndex && other.linear == block.linear)
+            {
+                vkFreeMemory(mDevice, block.memory, nullptr);
+                block = Block();
+                return;
+            }
+        }
+    }
+
+    bool Allocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& rangeOffset, VkDeviceSize& rangeSize, VkDeviceSize& offset)
+    {
+        auto best = block.freeRanges.end();
+        VkDeviceSize bestLeftover = UINT64_MAX;
+
+        for(auto it = block.freeRanges.begin(); it != block.freeRanges.end(); it++)
+        {
+            VkDeviceSize alignedOffset = AlignUp(it->first, alignment);
+            VkDeviceSize padding = alignedOffset - it->first;
+
+            if(padding + size > it->second)
+                continue;
+
+            VkDeviceSize leftover = it->second - padding - size;
+            if(leftover < bestLeftover)
+            {
+                best = it;
+                bestLeftover = leftover;
+                if(leftover == 0)
+                    break;
+            }
+        }
+
+        if(best == block.freeRanges.end())
+            return false;
+
+        VkDeviceSize start = best->first;
+        VkDeviceSize end = best->first + best->second;
+        block.freeRanges.erase(best);
+
+        offset = AlignUp(start, alignment);
+        rangeOffset = start;
+        rangeSize = offset + size - start;
+
+        if(end > rangeOffset + rangeSize)
+            block.freeRanges[rangeOffset + rangeSize] = end - (rangeOffset + rangeSize);
+
+        block.used += rangeSize;
+        block.allocationCount++;
+        return true;
+    }
+
+    Allocation Allocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, VkMemoryPropertyFlags preferred)
+    {
+        PROFILE_FUNCTION();
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        Allocation allocation;
+
+        VkMemoryPropertyFlags candidates[] = {properties | preferred, properties};
+        for(VkMemoryPropertyFlags flags : candidates)
+        {
+            for(uint32_t i = 0; i < mMemoryProperties.memoryTypeCount && allocation.memoryTypeIndex == UINT32_MAX; i++)
+            {
+                if(requirements.memoryTypeBits & (1 << i) && (mMemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+                {
+                    allocation.memoryTypeIndex = i;
+                }
+            }
+        }
+
+        if(allocation.memoryTypeIndex == UINT32_MAX)
+        {
+            std::println("Failed to find suitable memory type");
+            return allocation;
+        }
+
+        // linear and optimal resources only need separate blocks when the device asks for a granularity
+        if(mBufferImageGranularity <= 1)
+            linear = true;
+
+        allocation.size = requirements.size;
+        VkDeviceSize size = getSizeClass(requirements.size);
+        VkDeviceSize alignment = requirements.alignment > 0 ? requirements.alignment : 1;
+
+        // lazily allocated memory is only committed per image on tilers, sharing a block would defeat that
+        bool lazilyAllocated = mMemoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+        if(size > getBlockSize(allocation.memoryTypeIndex) / 2 || lazilyAllocated)
+        {
+            allocation.memory = allocateMemory(requirements.size, allocation.memoryTypeIndex, &allocation.map);
+            if(allocation.memory == VK_NULL_HANDLE)
+                return Allocation();
+
+            allocation.rangeSize = requirements.size;
+            mDedicatedBytes += requirements.size;
+            mDedicatedCount++;
+            mLiveBytes += requirements.size;
+            mAllocationCount++;
+            return allocation;
+        }
+
+        uint32_t blockIndex = UINT32_MAX;
+        for(uint32_t i = 0; i < mBlocks.size(); i++)
+        {
+            Block& block = mBlocks[i];
+            if(block.memory == VK_NULL_HANDLE || block.memoryTypeIndex != allocation.memoryTypeIndex || block.linear != linear)
+                continue;
+
+            if(block.size - block.used >= size && allocateFromBlock(block, size, alignment, allocation.rangeOffset, allocation.rangeSize, allocation.offset))
+            {
+                blockIndex = i;
+                break;
+            }
+        }
+
+        if(blockIndex == UINT32_MAX)
+        {
+            blockIndex = createBlock(allocation.memoryTypeIndex, linear);
+            if(blockIndex == UINT32_MAX || !allocateFromBlock(mBlocks[blockIndex], size, alignment, allocation.rangeOffset, allocation.rangeSize, allocation.offset))
+                return Allocation();
+        }
+
+        Block& block = mBlocks[blockIndex];
+        allocation.blockIndex = blockIndex;
+        allocation.memory = block.memory;
+        if(block.map != nullptr)
+            allocation.map = static_cast<char*>(block.map) + allocation.offset;
+
+        mLiveBytes += requirements.size;
+        mAllocationCount++;
+
+        return allocation;
+    }
+
+    void Allocator::Free(Allocation& allocation)
+    {
+        if(allocation.memory == VK_NULL_HANDLE)
+            return;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mLiveBytes -= allocation.size;
+        mAllocationCount--;
+
+        if(allocation.blockIndex == UINT32_MAX)
+        {
+            vkFreeMemory(mDevice, allocation.memory, nullptr);
+            mDedicatedBytes -= allocation.rangeSize;
+            mDedicatedCount--;
+            allocation = Allocation();
+            return;
+        }
+
+        Block& block = mBlocks[allocation.blockIndex];
+        block.used -= allocation.rangeSize;
+        block.allocationCount--;
+
+        auto it = block.freeRanges.emplace(allocation.rangeOffset, allocation.rangeSize).first;
+
+        auto next = std::next(it);
+        if(next != block.freeRanges.end() && it->first + it->second == next->first)
+        {
+            it->second += next->second;
+            block.freeRanges.erase(next);
+        }
+
+        if(it != block.freeRanges.begin())
+        {
+            auto previous = std::prev(it);
+            if(previous->first + previous->second == it->first)
+            {
+                previous->second += it->second;
+                block.freeRanges.erase(it);
+            }
+        }
+
+        if(block.allocationCount == 0)
+            releaseBlock(allocation.blockIndex);
+
+        allocation = Allocation();
+    }
+
+    AllocatorStats Allocator::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        AllocatorStats stats;
+        stats.liveBytes = mLiveBytes;
+        stats.allocationCount = mAllocationCount;
+        stats.dedicatedCount = mDedicatedCount;
+        stats.reservedBytes = mDedicatedBytes;
+
+        for(const Block& block : mBlocks)
+        {
+            if(block.memory == VK_NULL_HANDLE)
+                continue;
+
+            stats.blockCount++;
+            stats.reservedBytes += block.size;
+
+            for(const auto& [offset, size] : block.freeRanges)
+            {
+                stats.freeBytes += size;
+                if(size > stats.largestFreeRange)
+                    stats.largestFreeRange = size;
+            }
+        }
+
+        if(stats.freeBytes > 0)
+            stats.fragmentation = 1.f - float(stats.largestFreeRange) / float(stats.freeBytes);
+
+        return stats;
+    }
+
+    void Allocator::PrintStats() const
+    {
+        AllocatorStats stats = GetStats();
+        std::println("allocator: {} allocations, {} live bytes, {} reserved bytes in {} blocks + {} dedicated, {} free bytes, fragmentation {:.2f}",
+            stats.allocationCount, stats.liveBytes, stats.reservedBytes, stats.blockCount, stats.dedicatedCount, stats.freeBytes, stats.fragmentation);
+    }
+}
@@ -0,0 +1,172 @@
+#include <Vulkan/BarrierBatch.hpp>
+
+namespace vkn
+{
+    // the legacy flags share their bit values with the first 32 bits of the synchronization2 ones,
+    // anything only expressible in the upper bits falls back to the widest legacy scope
+    static VkPipelineStageFlags ToLegacyStage(VkPipelineStageFlags2 stage)
+    {
+        if(stage >> 32)
+            return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        return static_cast<VkPipelineStageFlags>(stage);
+    }
+
+    static VkAccessFlags ToLegacyAccess(VkAccessFlags2 access)
+    {
+        if(access >> 32)
+            return VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        return static_cast<VkAccessFlags>(access);
+    }
+
+    void BarrierBatch::ImageBarrier(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+    {
+        VkImageSubresourceRange range = {aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        ImageBarrier(image, range, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess, srcQueueFamily, dstQueueFamily);
+    }
+
+    void BarrierBatch::ImageBarrier(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+    {
+        VkImageMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        barrier.image = image;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = srcQueueFamily;
+        barrier.dstQueueFamilyIndex = dstQueueFamily;
+        barrier.subresourceRange = range;
+
+        mImageBarriers.push_back(barrier);
+        mSrcStageMask |= srcStage;
+        mDstStageMask |= dstStage;
+    }
+
+    void BarrierBatch::BufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+    {
+        VkBufferMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = srcQueueFamily;
+        barrier.dstQueueFamilyIndex = dstQueueFamily;
+
+        mBufferBarriers.push_back(barrier);
+        mSrcStageMask |= srcStage;
+        mDstStageMask |= dstStage;
+    }
+
+    void BarrierBatch::GlobalBarrier(VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+
+        mMemoryBarriers.push_back(barrier);
+        mSrcStageMask |= srcStage;
+        mDstStageMask |= dstStage;
+    }
+
+    void BarrierBatch::Append(const BarrierBatch& other)
+    {
+        mImageBarriers.insert(mImageBarriers.end(), other.mImageBarriers.begin(), other.mImageBarriers.end());
+        mBufferBarriers.insert(mBufferBarriers.end(), other.mBufferBarriers.begin(), other.mBufferBarriers.end());
+        mMemoryBarriers.insert(mMemoryBarriers.end(), other.mMemoryBarriers.begin(), other.mMemoryBarriers.end());
+        mSrcStageMask |= other.mSrcStageMask;
+        mDstStageMask |= other.mDstStageMask;
+    }
+
+    void BarrierBatch::Record(VkCommandBuffer commandBuffer, bool synchronization2)
+    {
+        if(IsEmpty())
+            return;
+
+        if(synchronization2)
+        {
+            VkDependencyInfo dependencyInfo = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+            dependencyInfo.imageMemoryBarrierCount = mImageBarriers.size();
+            dependencyInfo.pImageMemoryBarriers = mImageBarriers.data();
+            dependencyInfo.bufferMemoryBarrierCount = mBufferBarriers.size();
+            dependencyInfo.pBufferMemoryBarriers = mBufferBarriers.data();
+            dependencyInfo.memoryBarrierCount = mMemoryBarriers.size();
+            dependencyInfo.pMemoryBarriers = mMemoryBarriers.data();
+
+            vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+            Clear();
+            return;
+        }
+
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        imageBarriers.reserve(mImageBarriers.size());
+        for(const VkImageMemoryBarrier2& source : mImageBarriers)
+        {
+            VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            barrier.image = source.image;
+            barrier.oldLayout = source.oldLayout;
+            barrier.newLayout = source.newLayout;
+            barrier.srcAccessMask = ToLegacyAccess(source.srcAccessMask);
+            barrier.dstAccessMask = ToLegacyAccess(source.dstAccessMask);
+            barrier.srcQueueFamilyIndex = source.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = source.dstQueueFamilyIndex;
+            barrier.subresourceRange = source.subresourceRange;
+            imageBarriers.push_back(barrier);
+        }
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        bufferBarriers.reserve(mBufferBarriers.size());
+        for(const VkBufferMemoryBarrier2& source : mBufferBarriers)
+        {
+            VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+            barrier.buffer = source.buffer;
+            barrier.offset = source.offset;
+            barrier.size = source.size;
+            barrier.srcAccessMask = ToLegacyAccess(source.srcAccessMask);
+            barrier.dstAccessMask = ToLegacyAccess(source.dstAccessMask);
+            barrier.srcQueueFamilyIndex = source.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = source.dstQueueFamilyIndex;
+            bufferBarriers.push_back(barrier);
+        }
+
+        std::vector<VkMemoryBarrier> memoryBarriers;
+        memoryBarriers.reserve(mMemoryBarriers.size());
+        for(const VkMemoryBarrier2& source : mMemoryBarriers)
+        {
+            VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            barrier.srcAccessMask = ToLegacyAccess(source.srcAccessMask);
+            barrier.dstAccessMask = ToLegacyAccess(source.dstAccessMask);
+            memoryBarriers.push_back(barrier);
+        }
+
+        VkPipelineStageFlags srcStageMask = mSrcStageMask ? ToLegacyStage(mSrcStageMask) : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkPipelineStageFlags dstStageMask = mDstStageMask ? ToLegacyStage(mDstStageMask) : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0,
+            memoryBarriers.size(), memoryBarriers.data(),
+            bufferBarriers.size(), bufferBarriers.data(),
+            imageBarriers.size(), imageBarriers.data());
+
+        Clear();
+    }
+
+    void BarrierBatch::Clear()
+    {
+        mImageBarriers.clear();
+        mBufferBarriers.clear();
+        mMemoryBarriers.clear();
+        mSrcStageMask = 0;
+        mDstStageMask = 0;
+    }
+}
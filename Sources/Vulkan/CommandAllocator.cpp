@@ -0,0 +1,119 @@
+#include <Vulkan/CommandAllocator.hpp>
+#include <Macros.hpp>
+#include <unordered_map>
+
+namespace vkn
+{
+    static std::atomic<uint64_t> sNextAllocatorId = 1;
+
+    void CommandAllocator::Create(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount)
+    {
+        mDevice = device;
+        mQueueFamilyIndex = queueFamilyIndex;
+        mFrameCount = frameCount;
+        mFrameIndex = 0;
+        mId = sNextAllocatorId++;
+    }
+
+    void CommandAllocator::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for(std::unique_ptr<ThreadPools>& threadPools : mThreads)
+        {
+            for(Pool& pool : threadPools->frames)
+            {
+                vkDestroyCommandPool(mDevice, pool.commandPool, nullptr);
+            }
+        }
+        mThreads.clear();
+    }
+
+    void CommandAllocator::BeginFrame(uint32_t frameIndex, VkFence fence)
+    {
+        if(fence != VK_NULL_HANDLE)
+            vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFrameIndex = frameIndex % mFrameCount;
+
+        for(std::unique_ptr<ThreadPools>& threadPools : mThreads)
+        {
+            Pool& pool = threadPools->frames[mFrameIndex];
+            if(pool.usedPrimary == 0 && pool.usedSecondary == 0)
+                continue;
+
+            VK_CHECK(vkResetCommandPool(mDevice, pool.commandPool, 0));
+            pool.usedPrimary = 0;
+            pool.usedSecondary = 0;
+            mPoolResets++;
+        }
+    }
+
+    VkCommandBuffer CommandAllocator::Allocate(VkCommandBufferLevel level)
+    {
+        Pool& pool = getThreadPools().frames[mFrameIndex];
+
+        bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        std::vector<VkCommandBuffer>& commandBuffers = primary ? pool.primary : pool.secondary;
+        uint32_t& used = primary ? pool.usedPrimary : pool.usedSecondary;
+
+        if(used < commandBuffers.size())
+        {
+            mReuses++;
+            return commandBuffers[used++];
+        }
+
+        VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocateInfo.commandPool = pool.commandPool;
+        allocateInfo.commandBufferCount = 1;
+        allocateInfo.level = level;
+
+        VkCommandBuffer commandBuffer;
+        VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocateInfo, &commandBuffer));
+
+        commandBuffers.push_back(commandBuffer);
+        used++;
+        mAllocations++;
+        return commandBuffer;
+    }
+
+    CommandAllocatorStats CommandAllocator::GetStats() const
+    {
+        CommandAllocatorStats stats;
+        stats.allocations = mAllocations;
+        stats.reuses = mReuses;
+        stats.poolResets = mPoolResets;
+        return stats;
+    }
+
+    CommandAllocator::ThreadPools& CommandAllocator::getThreadPools()
+    {
+        // keyed by allocator id rather than address so a recreated allocator never sees stale pools
+        thread_local std::unordered_map<uint64_t, ThreadPools*> sThreadPools;
+
+        auto it = sThreadPools.find(mId);
+        if(it != sThreadPools.end())
+            return *it->second;
+
+        std::unique_ptr<ThreadPools> threadPools = std::make_unique<ThreadPools>();
+        threadPools->frames.resize(mFrameCount);
+
+        for(Pool& pool : threadPools->frames)
+        {
+            VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+            createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            createInfo.queueFamilyIndex = mQueueFamilyIndex;
+            VK_CHECK(vkCreateCommandPool(mDevice, &createInfo, nullptr, &pool.commandPool));
+        }
+
+        ThreadPools* result = threadPools.get();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mThreads.push_back(std::move(threadPools));
+        }
+
+        sThreadPools.emplace(mId, result);
+        return *result;
+    }
+}
@@ -0,0 +1,52 @@
+#include <Vulkan/DeletionQueue.hpp>
+
+namespace vkn
+{
+    void DeletionQueue::Create(uint32_t frameLatency)
+    {
+        mFrameLatency = frameLatency;
+        mFrame = 0;
+    }
+
+    void DeletionQueue::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // the caller has waited for the device to go idle, everything can go now
+        for(Entry& entry : mEntries)
+        {
+            entry.deleter();
+        }
+        mEntries.clear();
+    }
+
+    void DeletionQueue::BeginFrame()
+    {
+        std::deque<Entry> retired;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFrame++;
+
+            while(!mEntries.empty() && mEntries.front().frame + mFrameLatency <= mFrame)
+            {
+                retired.push_back(std::move(mEntries.front()));
+                mEntries.pop_front();
+            }
+        }
+
+        for(Entry& entry : retired)
+        {
+            entry.deleter();
+        }
+    }
+
+    void DeletionQueue::Push(std::function<void()>&& deleter)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        Entry entry;
+        entry.frame = mFrame;
+        entry.deleter = std::move(deleter);
+        mEntries.push_back(std::move(entry));
+    }
+}
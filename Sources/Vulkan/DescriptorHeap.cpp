@@ -0,0 +1,189 @@
+#include <Vulkan/DescriptorHeap.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Macros.hpp>
+#include <algorithm>
+
+namespace vkn
+{
+    static const uint32_t sTextureBinding = 0;
+    static const uint32_t sSamplerBinding = 1;
+    static const uint32_t sTextureArrayBinding = 2;
+
+    void DescriptorHeap::Create(const VulkanContext& context, uint32_t maxTextures, uint32_t maxSamplers, uint32_t maxTextureArrays)
+    {
+        mDevice = context.device;
+
+        VkPhysicalDeviceVulkan12Properties vulkan12Properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+        VkPhysicalDeviceProperties2 properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        properties.pNext = &vulkan12Properties;
+        vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties);
+
+        uint32_t textureLimit = vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages;
+        uint32_t samplerLimit = vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers;
+
+        // both image tables count against the same per stage limit
+        mMaxTextureArrays = std::min(maxTextureArrays, textureLimit / 2);
+        mMaxTextures = std::min(maxTextures, textureLimit - mMaxTextureArrays);
+        mMaxSamplers = std::min(maxSamplers, samplerLimit);
+
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        bindings[0] = CreateSetLayoutBinding(sTextureBinding, mMaxTextures, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[1] = CreateSetLayoutBinding(sSamplerBinding, mMaxSamplers, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[2] = CreateSetLayoutBinding(sTextureArrayBinding, mMaxTextureArrays, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+        VkDescriptorBindingFlags bindingFlags[3] = {};
+        bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        bindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        bindingFlags[2] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+        bindingFlagsInfo.bindingCount = 3;
+        bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutCreateInfo.pNext = &bindingFlagsInfo;
+        layoutCreateInfo.bindingCount = 3;
+        layoutCreateInfo.pBindings = bindings;
+
+        VK_CHECK(vkCreateDescriptorSetLayout(mDevice, &layoutCreateInfo, nullptr, &mSetLayout));
+
+        VkDescriptorPoolSize poolSizes[2] = {};
+        poolSizes[0] = CreatePoolSize(mMaxTextures + mMaxTextureArrays, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+        poolSizes[1] = CreatePoolSize(mMaxSamplers, VK_DESCRIPTOR_TYPE_SAMPLER);
+
+        VkDescriptorPoolCreateInfo poolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolCreateInfo.maxSets = 1;
+        poolCreateInfo.poolSizeCount = 2;
+        poolCreateInfo.pPoolSizes = poolSizes;
+
+        VK_CHECK(vkCreateDescriptorPool(mDevice, &poolCreateInfo, nullptr, &mPool));
+
+        mSet = AllocateDescriptorSet(mDevice, mPool, {mSetLayout});
+
+        mDefaultSampler = CreateSampler(mDevice);
+        RegisterSampler(mDefaultSampler);
+    }
+
+    void DescriptorHeap::Destroy()
+    {
+        vkDestroySampler(mDevice, mDefaultSampler, nullptr);
+        vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+
+        mSamplers.clear();
+        mFreeTextures.clear();
+        mFreeTextureArrays.clear();
+        mTextureCount = 0;
+        mTextureArrayCount = 0;
+    }
+
+    uint32_t DescriptorHeap::RegisterTexture(VkImageView imageView)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        uint32_t index = allocateIndex(mFreeTextures, mTextureCount, mMaxTextures, "textures");
+        if(index == UINT32_MAX)
+            return 0;
+
+        writeImage(sTextureBinding, index, imageView);
+        return index;
+    }
+
+    void DescriptorHeap::ReleaseTexture(uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFreeTextures.push_back(index);
+    }
+
+    uint32_t DescriptorHeap::RegisterTextureArray(VkImageView imageView)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        uint32_t index = allocateIndex(mFreeTextureArrays, mTextureArrayCount, mMaxTextureArrays, "texture arrays");
+        if(index == UINT32_MAX)
+            return 0;
+
+        writeImage(sTextureArrayBinding, index, imageView);
+        return index;
+    }
+
+    void DescriptorHeap::ReleaseTextureArray(uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFreeTextureArrays.push_back(index);
+    }
+
+    uint32_t DescriptorHeap::allocateIndex(std::vector<uint32_t>& freeIndices, uint32_t& count, uint32_t max, const char* name)
+    {
+        if(!freeIndices.empty())
+        {
+            uint32_t index = freeIndices.back();
+            freeIndices.pop_back();
+            return index;
+        }
+
+        if(count < max)
+            return count++;
+
+        std::println("descriptor heap full: {} {}", max, name);
+        return UINT32_MAX;
+    }
+
+    void DescriptorHeap::writeImage(uint32_t binding, uint32_t index, VkImageView imageView)
+    {
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageView = imageView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.descriptorCount = 1;
+        write.pImageInfo = &imageInfo;
+        write.dstSet = mSet;
+        write.dstBinding = binding;
+        write.dstArrayElement = index;
+
+        vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+    }
+
+    uint32_t DescriptorHeap::RegisterSampler(VkSampler sampler)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for(uint32_t i = 0; i < mSamplers.size(); i++)
+        {
+            if(mSamplers[i] == sampler)
+                return i;
+        }
+
+        if(mSamplers.size() >= mMaxSamplers)
+        {
+            std::println("descriptor heap full: {} samplers", mMaxSamplers);
+            return 0;
+        }
+
+        uint32_t index = mSamplers.size();
+        mSamplers.push_back(sampler);
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler = sampler;
+
+        VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        write.descriptorCount = 1;
+        write.pImageInfo = &imageInfo;
+        write.dstSet = mSet;
+        write.dstBinding = sSamplerBinding;
+        write.dstArrayElement = index;
+
+        vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+        return index;
+    }
+
+    void DescriptorHeap::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const
+    {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, setIndex, 1, &mSet, 0, nullptr);
+    }
+}
@@ -1,12 +1,37 @@
 #include <Vulkan/Functions.hpp>
+#include <Vulkan/UploadManager.hpp>
+#include <Vulkan/PipelineCache.hpp>
+#include <Vulkan/PipelineRegistry.hpp>
+#include <Vulkan/CommandAllocator.hpp>
+#include <Vulkan/DescriptorHeap.hpp>
+#include <Vulkan/GpuProfiler.hpp>
+#include <Vulkan/DeletionQueue.hpp>
+#include <Vulkan/ResourceCache.hpp>
+#include <Vulkan/TextureCache.hpp>
 #include <Macros.hpp>
+#include <Profiler.hpp>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
 
 
 namespace vkn
 {
-    VkSampleCountFlagBits GetSampleCount() 
+    VkSampleCountFlagBits GetSampleCount(VkPhysicalDevice physicalDevice, VkSampleCountFlagBits requested) 
     {
-        return VK_SAMPLE_COUNT_8_BIT;    
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        // software rasterizers like lavapipe top out below 8x, so clamp to what color and depth both support
+        VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+        for(VkSampleCountFlagBits samples : {VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT})
+        {
+            if(samples <= requested && (supported & samples))
+                return samples;
+        }
+
+        return VK_SAMPLE_COUNT_1_BIT;    
     }
 
     VkFormat GetDisplayFormat()
@@ -67,13 +92,20 @@ namespace vkn
         return capabilities.minImageCount + 1;
     }
 
-    VkInstance CreateInstance()
+    VkInstance CreateInstance(bool enableSurface)
     {
         VkInstance instance;
         VkInstanceCreateInfo createInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
 
-        uint32_t extensionCount;
-        const char** extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+        VkApplicationInfo applicationInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
+        applicationInfo.pApplicationName = "minevulkan";
+        applicationInfo.apiVersion = VK_API_VERSION_1_3;
+        createInfo.pApplicationInfo = &applicationInfo;
+
+        uint32_t extensionCount = 0;
+        const char** extensions = nullptr;
+        if(enableSurface)
+            extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
 
         for(int i = 0; i < extensionCount; i++)
         {
@@ -97,6 +129,26 @@ namespace vkn
         return instance;
     }
 
+    // the bindless heap and shader.frag index runtime arrays with nonuniformEXT, there is no path without it
+    static bool SupportsDescriptorIndexing(VkPhysicalDevice physicalDevice)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        if(properties.apiVersion < VK_API_VERSION_1_2)
+            return false;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        VkPhysicalDeviceFeatures2 features2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        features2.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        return vulkan12Features.runtimeDescriptorArray
+            && vulkan12Features.descriptorBindingPartiallyBound
+            && vulkan12Features.descriptorBindingSampledImageUpdateAfterBind
+            && vulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+    }
+
     VkPhysicalDevice GetPhysicalDevice(VkInstance instance)
     {
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
@@ -106,6 +158,8 @@ namespace vkn
         std::vector<VkPhysicalDevice> physicalDevices(count);
         vkEnumeratePhysicalDevices(instance, &count, physicalDevices.data());
 
+        std::erase_if(physicalDevices, [](VkPhysicalDevice device) { return !SupportsDescriptorIndexing(device); });
+
         for(VkPhysicalDevice device : physicalDevices)
         {
             VkPhysicalDeviceProperties properties;
@@ -121,6 +175,18 @@ namespace vkn
                 physicalDevice = device;
             }
         }
+
+        // headless runs on ci machines may only expose a cpu or virtual device
+        if(physicalDevice == VK_NULL_HANDLE && !physicalDevices.empty())
+        {
+            physicalDevice = physicalDevices.front();
+        }
+
+        if(physicalDevice == VK_NULL_HANDLE)
+        {
+            std::println("Failed to find a vulkan 1.2 device with descriptor indexing");
+            std::abort();
+        }
         
         // TODO: find optimal device based on a score
 
@@ -149,66 +215,126 @@ namespace vkn
             {
                 queueIndices.graphic = i;
             }
-            if(properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT && queueIndices.compute == UINT32_MAX)
+            if(properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT && !(properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && queueIndices.compute == UINT32_MAX)
             {
                 queueIndices.compute = i;
             }
-            if(properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT && queueIndices.transfer == UINT32_MAX)
+            if(properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT && !(properties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && queueIndices.transfer == UINT32_MAX)
             {
                 queueIndices.transfer = i;
             }
             VkBool32 supported = VK_FALSE;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supported);
+            if(surface != VK_NULL_HANDLE)
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supported);
             if(supported && queueIndices.present == UINT32_MAX)
             {
                 queueIndices.present = i;
             }
         }
 
+        // fall back to the graphic family when the device has no dedicated compute or transfer family
+        if(queueIndices.compute == UINT32_MAX)
+        {
+            queueIndices.compute = queueIndices.graphic;
+        }
+        if(queueIndices.transfer == UINT32_MAX)
+        {
+            queueIndices.transfer = queueIndices.graphic;
+        }
+        if(surface == VK_NULL_HANDLE)
+        {
+            queueIndices.present = queueIndices.graphic;
+        }
+
         return queueIndices;
     }
 
-    VkDevice CreateDevice(VkPhysicalDevice physicalDevice, const QueueIndices& queueIndices)
+    DeviceFeatures GetDeviceFeatures(VkPhysicalDevice physicalDevice)
+    {
+        DeviceFeatures features;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        if(properties.apiVersion < VK_API_VERSION_1_2)
+            return features;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        VkPhysicalDeviceVulkan13Features vulkan13Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+        VkPhysicalDeviceFeatures2 features2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        features2.pNext = &vulkan12Features;
+        if(properties.apiVersion >= VK_API_VERSION_1_3)
+            vulkan12Features.pNext = &vulkan13Features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        features.synchronization2 = vulkan13Features.synchronization2;
+        features.multiDrawIndirect = features2.features.multiDrawIndirect;
+        features.textureCompressionBC = features2.features.textureCompressionBC;
+        features.drawIndirectCount = vulkan12Features.drawIndirectCount && features.multiDrawIndirect;
+
+        std::println("synchronization2: {}", features.synchronization2 ? "enabled" : "unsupported, using legacy barriers");
+        std::println("draw indirect count: {}", features.drawIndirectCount ? "enabled" : "unsupported, culled draws are zeroed in place");
+        std::println("bc texture compression: {}", features.textureCompressionBC ? "enabled" : "unsupported, textures are decoded from png");
+        return features;
+    }
+
+    VkDevice CreateDevice(VkPhysicalDevice physicalDevice, const QueueIndices& queueIndices, const DeviceFeatures& features)
     {
         VkDeviceCreateInfo createInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
 
         const char* extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
         createInfo.ppEnabledExtensionNames = extensions;
-        createInfo.enabledExtensionCount = 1;
+        createInfo.enabledExtensionCount = features.swapchain ? 1 : 0;
 
 
         float priority = 1.f;
 
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+        uint32_t families[] = {queueIndices.graphic, queueIndices.present, queueIndices.transfer, queueIndices.compute};
 
-        VkDeviceQueueCreateInfo graphicQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-        graphicQueueCreateInfo.pQueuePriorities = &priority;
-        graphicQueueCreateInfo.queueCount = 1;
-        graphicQueueCreateInfo.queueFamilyIndex = queueIndices.graphic;
-
-        VkDeviceQueueCreateInfo presentQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-        presentQueueCreateInfo.pQueuePriorities = &priority;
-        presentQueueCreateInfo.queueCount = 1;
-        presentQueueCreateInfo.queueFamilyIndex = queueIndices.present;
-
-        VkDeviceQueueCreateInfo computeQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-
+        for(uint32_t family : families)
+        {
+            bool found = false;
+            for(const VkDeviceQueueCreateInfo& queueCreateInfo : queueCreateInfos)
+            {
+                found |= queueCreateInfo.queueFamilyIndex == family;
+            }
 
-        VkDeviceQueueCreateInfo queueCreateInfos[] = {graphicQueueCreateInfo, presentQueueCreateInfo};
+            if(found || family == UINT32_MAX)
+                continue;
 
-        if(queueIndices.graphic != queueIndices.present)
-        {
-            createInfo.queueCreateInfoCount = 2;
-            createInfo.pQueueCreateInfos = queueCreateInfos;
+            VkDeviceQueueCreateInfo queueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+            queueCreateInfo.pQueuePriorities = &priority;
+            queueCreateInfo.queueCount = 1;
+            queueCreateInfo.queueFamilyIndex = family;
+            queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        createInfo.queueCreateInfoCount = 1;
-        createInfo.pQueueCreateInfos = &graphicQueueCreateInfo;
+        createInfo.queueCreateInfoCount = queueCreateInfos.size();
+        createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         VkPhysicalDeviceFeatures enableFeatures = {};
         enableFeatures.samplerAnisotropy = VK_TRUE;
+        enableFeatures.multiDrawIndirect = features.multiDrawIndirect;
+        enableFeatures.textureCompressionBC = features.textureCompressionBC;
         createInfo.pEnabledFeatures = &enableFeatures;
 
+        VkPhysicalDeviceVulkan13Features vulkan13Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+        vulkan13Features.synchronization2 = features.synchronization2;
+        if(features.synchronization2)
+            createInfo.pNext = &vulkan13Features;
+
+        // GetPhysicalDevice only returns devices with descriptor indexing
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.drawIndirectCount = features.drawIndirectCount;
+        vulkan12Features.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &vulkan12Features;
+
         VkDevice device;
         vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
         return device;
@@ -219,35 +345,41 @@ namespace vkn
         Queues queue;
         vkGetDeviceQueue(device, queueIndices.graphic, 0, &queue.graphic);
         vkGetDeviceQueue(device, queueIndices.present, 0, &queue.present);
+        vkGetDeviceQueue(device, queueIndices.transfer, 0, &queue.transfer);
+        vkGetDeviceQueue(device, queueIndices.compute, 0, &queue.compute);
         return queue;
     }
 
-    VkRenderPass CreateRenderPass(VkDevice device)
+    VkRenderPass CreateRenderPass(VkDevice device, VkSampleCountFlagBits samples, VkImageLayout finalLayout, bool keepDepth)
     {
+        // without msaa the color attachment is the target itself and there is nothing to resolve
+        bool resolve = samples != VK_SAMPLE_COUNT_1_BIT;
+
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = GetDisplayFormat();
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : finalLayout;
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        // only the resolved image is ever read, the multisampled one can stay in tile memory
+        colorAttachment.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.samples = GetSampleCount();
+        colorAttachment.samples = samples;
 
         VkAttachmentDescription depthAttachment = {};
         depthAttachment.format = VK_FORMAT_D32_SFLOAT;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = keepDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.storeOp = keepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.samples = GetSampleCount();
+        depthAttachment.samples = samples;
 
         VkAttachmentDescription colorAttachmentResolve = {};
         colorAttachmentResolve.format = GetDisplayFormat();
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachmentResolve.finalLayout = finalLayout;
         colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -271,12 +403,13 @@ namespace vkn
         subpassDescription.colorAttachmentCount = 1;
         subpassDescription.pColorAttachments = &colorAttachmentRef;
         subpassDescription.pDepthStencilAttachment = &depthAttachmentRef;
-        subpassDescription.pResolveAttachments = &colorAttachmentResolveRef;
+        subpassDescription.pResolveAttachments = resolve ? &colorAttachmentResolveRef : nullptr;
 
+        // transfer covers the upscale blit of the previous frame still reading the scene image
         VkSubpassDependency subpassDependencies = {};
         subpassDependencies.srcSubpass = VK_SUBPASS_EXTERNAL;
         subpassDependencies.dstSubpass = 0;
-        subpassDependencies.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subpassDependencies.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
         subpassDependencies.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
         subpassDependencies.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         subpassDependencies.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -284,7 +417,7 @@ namespace vkn
         VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment, colorAttachmentResolve};
 
         VkRenderPassCreateInfo createInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
-        createInfo.attachmentCount = 3;
+        createInfo.attachmentCount = resolve ? 3 : 2;
         createInfo.pAttachments = attachments;
         createInfo.subpassCount = 1;
         createInfo.pSubpasses = &subpassDescription;
@@ -297,8 +430,153 @@ namespace vkn
         return renderPass;
     }
 
-    Swapchain CreateSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkRenderPass renderPass, GLFWwindow* window) 
+    VkRenderPass CreateDepthRenderPass(VkDevice device, VkFormat format, VkImageLayout finalLayout)
     {
+        VkAttachmentDescription depthAttachment = {};
+        depthAttachment.format = format;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = finalLayout;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkAttachmentReference depthAttachmentRef = {};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpassDescription = {};
+        subpassDescription.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // the depth is read by compute afterwards, and the previous frame's compute reads have to finish before it is cleared again
+        VkSubpassDependency subpassDependencies[2] = {};
+        subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        subpassDependencies[0].dstSubpass = 0;
+        subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subpassDependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subpassDependencies[1].srcSubpass = 0;
+        subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        subpassDependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        VkRenderPassCreateInfo createInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+        createInfo.attachmentCount = 1;
+        createInfo.pAttachments = &depthAttachment;
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpassDescription;
+        createInfo.dependencyCount = 2;
+        createInfo.pDependencies = subpassDependencies;
+
+        VkRenderPass renderPass;
+        VK_CHECK(vkCreateRenderPass(device, &createInfo, nullptr, &renderPass));
+
+        return renderPass;
+    }
+
+    VkRenderPass GetRenderPass(VulkanContext& context, const RenderQuality& quality, VkImageLayout finalLayout)
+    {
+        // render passes are kept for the lifetime of the context, so a handle is never reused
+        // for a different variant and pipelines keyed on it stay valid when switching back
+        for(const RenderPassVariant& variant : context.renderPasses)
+        {
+            if(variant.samples == quality.samples && variant.finalLayout == finalLayout && variant.keepDepth == quality.keepDepth)
+                return variant.renderPass;
+        }
+
+        RenderPassVariant variant;
+        variant.samples = quality.samples;
+        variant.finalLayout = finalLayout;
+        variant.keepDepth = quality.keepDepth;
+        variant.renderPass = CreateRenderPass(context.device, quality.samples, finalLayout, quality.keepDepth);
+        context.renderPasses.push_back(variant);
+
+        return variant.renderPass;
+    }
+
+    static bool IsScaled(const RenderQuality& quality)
+    {
+        return quality.renderScale != 1.f;
+    }
+
+    static VkExtent2D GetRenderExtent(VkExtent2D extent, const RenderQuality& quality)
+    {
+        VkExtent2D renderExtent;
+        renderExtent.width = std::max(1u, uint32_t(extent.width * quality.renderScale));
+        renderExtent.height = std::max(1u, uint32_t(extent.height * quality.renderScale));
+        return renderExtent;
+    }
+
+    static VkImageLayout GetRenderPassFinalLayout(const VulkanContext& context, const RenderQuality& quality)
+    {
+        return context.headless || IsScaled(quality) ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+
+    // moves over whatever attachments still fit the target's extent and quality
+    static void TakeSwapchainTargets(Swapchain& from, Swapchain& to)
+    {
+        bool sameExtent = from.renderExtent.width == to.renderExtent.width && from.renderExtent.height == to.renderExtent.height;
+
+        if(sameExtent && from.quality.samples == to.quality.samples)
+        {
+            to.colorImage = from.colorImage;
+            from.colorImage = Image();
+        }
+
+        if(sameExtent && from.quality.samples == to.quality.samples && from.quality.keepDepth == to.quality.keepDepth)
+        {
+            to.depthImage = from.depthImage;
+            from.depthImage = Image();
+        }
+    }
+
+    static void CreateSwapchainAttachments(VkRenderPass renderPass, Swapchain& swapchain)
+    {
+        VkDevice device = swapchain.allocator->GetDevice();
+        VkExtent2D extent = swapchain.renderExtent;
+        VkSampleCountFlagBits samples = swapchain.quality.samples;
+        bool resolve = samples != VK_SAMPLE_COUNT_1_BIT;
+
+        // attachments handed over from the previous swapchain already match the extent
+        // depth is only sampled afterwards when a later pass asked for it, otherwise it is as transient as the msaa color
+        VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (swapchain.quality.keepDepth ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+
+        if(swapchain.depthImage.handle == VK_NULL_HANDLE)
+            swapchain.depthImage = CreateImage(swapchain.allocator, extent.width, extent.height, VK_FORMAT_D32_SFLOAT, depthUsage, samples);
+
+        if(swapchain.colorImage.handle == VK_NULL_HANDLE && resolve)
+            swapchain.colorImage = CreateImage(swapchain.allocator, extent.width, extent.height, GetDisplayFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, samples);
+
+        // a scaled render lands in a render graph image that is blitted to the swapchain image afterwards, the graph owns that framebuffer
+        if(IsScaled(swapchain.quality))
+            return;
+
+        VkFramebufferCreateInfo framebufferCreateInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        framebufferCreateInfo.attachmentCount = resolve ? 3 : 2;
+        framebufferCreateInfo.width = extent.width;
+        framebufferCreateInfo.height = extent.height;
+        framebufferCreateInfo.layers = 1;
+        framebufferCreateInfo.renderPass = renderPass;
+
+        swapchain.framebuffers.resize(swapchain.images.size());
+
+        for(int i = 0; i < swapchain.images.size(); i++)
+        {
+            VkImageView resolveAttachments[] = {swapchain.colorImage.imageView, swapchain.depthImage.imageView, swapchain.imageViews[i]};
+            VkImageView attachments[] = {swapchain.imageViews[i], swapchain.depthImage.imageView};
+            framebufferCreateInfo.pAttachments = resolve ? resolveAttachments : attachments;
+            VK_CHECK(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &swapchain.framebuffers[i]));
+        }
+    }
+
+    Swapchain CreateSwapchain(VkPhysicalDevice physicalDevice, Allocator* allocator, VkSurfaceKHR surface, VkRenderPass renderPass, GLFWwindow* window, const RenderQuality& quality, Swapchain* oldSwapchain) 
+    {
+        PROFILE_FUNCTION();
+        VkDevice device = allocator->GetDevice();
+
         VkSwapchainCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
         createInfo.surface = surface;
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -310,11 +588,23 @@ namespace vkn
         createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         createInfo.minImageCount = GetRequiredSwapchainImageCount(physicalDevice, surface);
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if(SupportsUpscaleBlit(physicalDevice, surface))
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
         createInfo.presentMode = GetDisplayPresentMode();
         createInfo.preTransform = GetDisplayTransform(physicalDevice, surface);
 
         Swapchain swapchain;
         swapchain.extent = createInfo.imageExtent;
+        swapchain.renderExtent = GetRenderExtent(swapchain.extent, quality);
+        swapchain.quality = quality;
+        swapchain.allocator = allocator;
+
+        // the old swapchain keeps its images, views and framebuffers until the caller retires them
+        if(oldSwapchain != nullptr)
+        {
+            createInfo.oldSwapchain = oldSwapchain->handle;
+            TakeSwapchainTargets(*oldSwapchain, swapchain);
+        }
 
         VK_CHECK(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain.handle));
 
@@ -336,122 +626,119 @@ namespace vkn
         imageViewCreateInfo.subresourceRange.levelCount = 1;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
 
-        VkFramebufferCreateInfo framebufferCreateInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-        framebufferCreateInfo.attachmentCount = 3;
-        framebufferCreateInfo.width = GetDisplayExtent(window).width;
-        framebufferCreateInfo.height = GetDisplayExtent(window).height;
-        framebufferCreateInfo.layers = 1;
-        framebufferCreateInfo.renderPass = renderPass;
-
-
         swapchain.imageViews.resize(swapchain.images.size());
-        swapchain.framebuffers.resize(swapchain.images.size());
-
-        
-        
-        VkImageCreateInfo depthImageCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
-        depthImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        depthImageCreateInfo.arrayLayers = 1;
-        depthImageCreateInfo.extent.width = swapchain.extent.width;
-        depthImageCreateInfo.extent.height = swapchain.extent.height;
-        depthImageCreateInfo.extent.depth = 1;
-        depthImageCreateInfo.format = VK_FORMAT_D32_SFLOAT;
-        depthImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthImageCreateInfo.mipLevels = 1;
-        depthImageCreateInfo.samples = GetSampleCount();
-        depthImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        depthImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        depthImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-        vkCreateImage(device, &depthImageCreateInfo, nullptr, &swapchain.depthImage);
-
-        VkMemoryRequirements requirements;
-        vkGetImageMemoryRequirements(device, swapchain.depthImage, &requirements);
-
-        VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-        allocateInfo.allocationSize = requirements.size;
-        allocateInfo.memoryTypeIndex = GetMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        vkAllocateMemory(device, &allocateInfo, nullptr, &swapchain.depthImageMemory);
-
-        vkBindImageMemory(device, swapchain.depthImage, swapchain.depthImageMemory, 0);
-
-
-        VkImageViewCreateInfo depthImageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
-        depthImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        depthImageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        depthImageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        depthImageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        depthImageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        depthImageViewCreateInfo.format = VK_FORMAT_D32_SFLOAT;
-        depthImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        depthImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        depthImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        depthImageViewCreateInfo.subresourceRange.levelCount = 1;
-        depthImageViewCreateInfo.subresourceRange.layerCount = 1;
-        depthImageViewCreateInfo.image = swapchain.depthImage;
+        for(int i = 0; i < swapchain.images.size(); i++)
+        {
+            imageViewCreateInfo.image = swapchain.images[i];
+            VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &swapchain.imageViews[i]));
+        }
 
-        vkCreateImageView(device, &depthImageViewCreateInfo, nullptr, &swapchain.depthImageView);
+        CreateSwapchainAttachments(renderPass, swapchain);
 
+        return swapchain;
+    }
 
+    Swapchain CreateOffscreenSwapchain(Allocator* allocator, VkRenderPass renderPass, VkExtent2D extent, uint32_t imageCount, const RenderQuality& quality)
+    {
+        PROFILE_FUNCTION();
+        Swapchain swapchain;
+        swapchain.extent = extent;
+        swapchain.renderExtent = GetRenderExtent(extent, quality);
+        swapchain.quality = quality;
+        swapchain.allocator = allocator;
 
-        VkImageCreateInfo colorImageCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
-        colorImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        colorImageCreateInfo.arrayLayers = 1;
-        colorImageCreateInfo.extent.width = swapchain.extent.width;
-        colorImageCreateInfo.extent.height = swapchain.extent.height;
-        colorImageCreateInfo.extent.depth = 1;
-        colorImageCreateInfo.format = GetDisplayFormat();
-        colorImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorImageCreateInfo.mipLevels = 1;
-        colorImageCreateInfo.samples = GetSampleCount();
-        colorImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        colorImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        colorImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        for(uint32_t i = 0; i < imageCount; i++)
+        {
+            Image image = CreateImage(allocator, extent.width, extent.height, GetDisplayFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+            swapchain.offscreenImages.push_back(image);
+            swapchain.images.push_back(image.handle);
+            swapchain.imageViews.push_back(image.imageView);
+        }
 
-        vkCreateImage(device, &colorImageCreateInfo, nullptr, &swapchain.colorImage);
+        CreateSwapchainAttachments(renderPass, swapchain);
 
-        vkGetImageMemoryRequirements(device, swapchain.colorImage, &requirements);
+        return swapchain;
+    }
 
-        allocateInfo.allocationSize = requirements.size;
-        allocateInfo.memoryTypeIndex = GetMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Swapchain RebuildSwapchainTargets(Swapchain& swapchain, VkRenderPass renderPass, const RenderQuality& quality)
+    {
+        PROFILE_FUNCTION();
+        Swapchain retired;
+        retired.allocator = swapchain.allocator;
+        retired.renderExtent = swapchain.renderExtent;
+        retired.quality = swapchain.quality;
+        retired.depthImage = swapchain.depthImage;
+        retired.colorImage = swapchain.colorImage;
+        retired.framebuffers = swapchain.framebuffers;
+
+        swapchain.depthImage = Image();
+        swapchain.colorImage = Image();
+        swapchain.framebuffers.clear();
+        swapchain.renderExtent = GetRenderExtent(swapchain.extent, quality);
+        swapchain.quality = quality;
+
+        TakeSwapchainTargets(retired, swapchain);
+        CreateSwapchainAttachments(renderPass, swapchain);
+
+        return retired;
+    }
 
-        vkAllocateMemory(device, &allocateInfo, nullptr, &swapchain.colorImageMemory);
+    bool SupportsUpscaleBlit(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
+    {
+        if(surface == VK_NULL_HANDLE)
+            return true;
 
-        vkBindImageMemory(device, swapchain.colorImage, swapchain.colorImageMemory, 0);
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+        return capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
+    RenderQuality ClampRenderQuality(const VulkanContext& context, RenderQuality quality)
+    {
+        quality.samples = GetSampleCount(context.physicalDevice, quality.samples);
+        quality.renderScale = std::clamp(quality.renderScale, 0.25f, 2.f);
 
-        VkImageViewCreateInfo colorImageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
-        colorImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        colorImageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        colorImageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        colorImageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        colorImageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        colorImageViewCreateInfo.format = GetDisplayFormat();
-        colorImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        colorImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        colorImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        colorImageViewCreateInfo.subresourceRange.levelCount = 1;
-        colorImageViewCreateInfo.subresourceRange.layerCount = 1;
-        colorImageViewCreateInfo.image = swapchain.colorImage;
+        if(IsScaled(quality) && !SupportsUpscaleBlit(context.physicalDevice, context.surface))
+        {
+            std::println("render scale unsupported, the swapchain can't be a blit destination");
+            quality.renderScale = 1.f;
+        }
 
-        vkCreateImageView(device, &colorImageViewCreateInfo, nullptr, &swapchain.colorImageView);
+        return quality;
+    }
 
+    void SetRenderQuality(VulkanContext& context, const RenderQuality& requested)
+    {
+        PROFILE_FUNCTION();
+        RenderQuality quality = ClampRenderQuality(context, requested);
 
+        context.renderPass = GetRenderPass(context, quality, GetRenderPassFinalLayout(context, quality));
+        context.quality = quality;
 
+        // the swapchain images themselves are untouched, only what depends on the quality is rebuilt
+        Swapchain retired = RebuildSwapchainTargets(context.swapchain, context.renderPass, quality);
 
-        for(int i = 0; i < swapchain.images.size(); i++)
+        VkDevice device = context.device;
+        context.deletionQueue->Push([device, retired]() mutable
         {
-            imageViewCreateInfo.image = swapchain.images[i];
-            VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &swapchain.imageViews[i]));
+            DestroySwapchain(device, retired);
+        });
 
+        std::println("render quality: {}x msaa, {:.2f} render scale, {}x{} internal", uint32_t(quality.samples), quality.renderScale, context.swapchain.renderExtent.width, context.swapchain.renderExtent.height);
+    }
 
-            VkImageView attachments[] = {swapchain.colorImageView, swapchain.depthImageView, swapchain.imageViews[i]};
-            framebufferCreateInfo.pAttachments = attachments;
-            VK_CHECK(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &swapchain.framebuffers[i]));
-        }
-
-        return swapchain;
+    void RecordImageBlit(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage destination, VkExtent2D destinationExtent)
+    {
+        VkImageBlit region = {};
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffsets[1] = {int32_t(sourceExtent.width), int32_t(sourceExtent.height), 1};
+        region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.dstSubresource.layerCount = 1;
+        region.dstOffsets[1] = {int32_t(destinationExtent.width), int32_t(destinationExtent.height), 1};
+
+        vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
     }
 
     VkSemaphore CreateSemaphore(VkDevice device)
@@ -475,11 +762,12 @@ namespace vkn
         return fence;
     }
 
-    VkCommandPool CreateCommandPool(VkDevice device)
+    VkCommandPool CreateCommandPool(VkDevice device, uint32_t queueFamilyIndex)
     {
         VkCommandPool commandPool = VK_NULL_HANDLE;
         VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
         createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        createInfo.queueFamilyIndex = queueFamilyIndex;
 
         VK_CHECK(vkCreateCommandPool(device, &createInfo, nullptr, &commandPool));
         return commandPool;
@@ -498,11 +786,13 @@ namespace vkn
         return commandBuffer;
     }
 
-    VkPipelineLayout CreatePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts) 
+    VkPipelineLayout CreatePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) 
     {
         VkPipelineLayoutCreateInfo createInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
         createInfo.setLayoutCount = setLayouts.size();
         createInfo.pSetLayouts = setLayouts.data();
+        createInfo.pushConstantRangeCount = pushConstantRanges.size();
+        createInfo.pPushConstantRanges = pushConstantRanges.data();
 
         VkPipelineLayout pipelineLayout;
         VK_CHECK(vkCreatePipelineLayout(device, &createInfo, nullptr, &pipelineLayout));
@@ -510,38 +800,86 @@ namespace vkn
     }
 
 
-    VkShaderModule CreateShaderModuleFromFile(VkDevice device, const char* filename)
+    std::vector<uint32_t> ReadShaderFile(const char* filename)
     {
         FILE* fp = fopen(filename, "rb");
-        if(fp == NULL) { std::println("Failed to open file: {}", filename); }
+        if(fp == NULL)
+        {
+            std::println("Failed to open file: {}", filename);
+            return {};
+        }
 
         fseek(fp, 0L, SEEK_END);
         size_t size = ftell(fp);
         fseek(fp, 0L, SEEK_SET);
 
-        char* buffer = new char[size];
+        // spir-v is a stream of words, a size that isn't a multiple of 4 is a broken file
+        std::vector<uint32_t> code(size / sizeof(uint32_t));
+        if(size % sizeof(uint32_t) != 0 || fread(code.data(), size, 1, fp) != 1)
+        {
+            std::println("Failed to read shader: {}", filename);
+            code.clear();
+        }
+
+        fclose(fp);
+        return code;
+    }
 
-        fread(buffer, size, 1, fp);
+    VkShaderModule CreateShaderModule(VkDevice device, std::span<const uint32_t> code)
+    {
+        if(code.empty())
+            return VK_NULL_HANDLE;
 
         VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-        createInfo.codeSize = size;
-        createInfo.pCode = (uint32_t*)buffer;
+        createInfo.codeSize = code.size_bytes();
+        createInfo.pCode = code.data();
 
         VkShaderModule shaderModule;
         VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
         return shaderModule;
     }
 
-    VkPipeline CreateGraphicsPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule, VkViewport viewport, const std::vector<VkVertexInputBindingDescription>& vertexInputBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions)
+    VkShaderModule CreateShaderModuleFromFile(VkDevice device, const char* filename)
+    {
+        return CreateShaderModule(device, ReadShaderFile(filename));
+    }
+
+    VkPipeline CreateComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout layout, VkShaderModule shaderModule)
     {
+        PROFILE_FUNCTION();
+
+        VkComputePipelineCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        createInfo.stage.module = shaderModule;
+        createInfo.stage.pName = "main";
+        createInfo.layout = layout;
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline));
+        return pipeline;
+    }
+
+    VkPipeline CreateGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDescription& description)
+    {
+        PROFILE_FUNCTION();
         
         VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
         colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.blendEnable = description.blendEnable;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        // no fragment shader means a depth only pass without color attachments
+        bool depthOnly = description.fragmentShaderModule == VK_NULL_HANDLE;
 
         VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
         colorBlendStateCreateInfo.pAttachments = &colorBlendAttachment;
-        colorBlendStateCreateInfo.attachmentCount = 1;
+        colorBlendStateCreateInfo.attachmentCount = depthOnly ? 0 : 1;
 
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
         inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
@@ -549,41 +887,34 @@ namespace vkn
 
 
         VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-        vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions.data();
-        vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
-        vertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexInputBindingDescriptions.size();
-        vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexInputAttributeDescriptions.size();
+        vertexInputStateCreateInfo.pVertexBindingDescriptions = description.vertexBindings.data();
+        vertexInputStateCreateInfo.pVertexAttributeDescriptions = description.vertexAttributes.data();
+        vertexInputStateCreateInfo.vertexBindingDescriptionCount = description.vertexBindings.size();
+        vertexInputStateCreateInfo.vertexAttributeDescriptionCount = description.vertexAttributes.size();
         
         VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
-        rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;
+        rasterizationStateCreateInfo.cullMode = description.cullMode;
         rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizationStateCreateInfo.frontFace = description.frontFace;
         rasterizationStateCreateInfo.lineWidth = 1.f;
         rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
 
         VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
         // multisampleStateCreateInfo.sampleShadingEnable = VK_TRUE;
-        multisampleStateCreateInfo.rasterizationSamples = GetSampleCount();
-
-        VkRect2D scissor;
-        scissor.extent.width = viewport.width;
-        scissor.extent.height = viewport.height;
-        scissor.offset = {0,0};
-
+        multisampleStateCreateInfo.rasterizationSamples = description.samples;
 
+        // viewport and scissor are dynamic, only the counts are baked into the pipeline
         VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
         viewportStateCreateInfo.viewportCount = 1;
         viewportStateCreateInfo.scissorCount = 1;
-        viewportStateCreateInfo.pScissors = &scissor;
-        viewportStateCreateInfo.pViewports = &viewport;
         
         VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
         vertexShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertexShaderStageCreateInfo.module = vertexShaderModule;
+        vertexShaderStageCreateInfo.module = description.vertexShaderModule;
         vertexShaderStageCreateInfo.pName = "main";
         VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
         fragmentShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragmentShaderStageCreateInfo.module = fragmentShaderModule;
+        fragmentShaderStageCreateInfo.module = description.fragmentShaderModule;
         fragmentShaderStageCreateInfo.pName = "main";
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo};
@@ -596,41 +927,59 @@ namespace vkn
 
         VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
         depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
-        depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
-        depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+        depthStencilStateCreateInfo.depthTestEnable = description.depthTest;
+        depthStencilStateCreateInfo.depthWriteEnable = description.depthWrite;
         depthStencilStateCreateInfo.maxDepthBounds = 1.f;
         depthStencilStateCreateInfo.minDepthBounds = 0.f;
-        depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencilStateCreateInfo.depthCompareOp = description.depthCompareOp;
         depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
 
         VkGraphicsPipelineCreateInfo graphicPipelineCreateInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-        graphicPipelineCreateInfo.layout = pipelineLayout;
+        graphicPipelineCreateInfo.layout = description.layout;
         graphicPipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
         graphicPipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
         graphicPipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
         graphicPipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
         graphicPipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
         graphicPipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-        graphicPipelineCreateInfo.stageCount = 2;
+        graphicPipelineCreateInfo.stageCount = depthOnly ? 1 : 2;
         graphicPipelineCreateInfo.pStages = shaderStages;
-        graphicPipelineCreateInfo.renderPass = renderPass;
+        graphicPipelineCreateInfo.renderPass = description.renderPass;
         graphicPipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
         graphicPipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
         
 
+        auto start = std::chrono::steady_clock::now();
+
         VkPipeline graphicPipeline;
-        vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicPipelineCreateInfo, nullptr, &graphicPipeline);
+        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicPipelineCreateInfo, nullptr, &graphicPipeline));
+
+        std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        std::println("graphics pipeline created in {:.3f} ms", duration.count());
+
         return graphicPipeline;
     }
 
     void DestroySwapchain(VkDevice device, Swapchain& swapchain) 
     {
-        for(int i = 0; i < swapchain.images.size(); i++)
+        for(VkFramebuffer framebuffer : swapchain.framebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        for(int i = 0; i < swapchain.imageViews.size() && swapchain.offscreenImages.empty(); i++)
         {
-            vkDestroyFramebuffer(device, swapchain.framebuffers[i], nullptr);
             vkDestroyImageView(device, swapchain.imageViews[i], nullptr);
         }
-        vkDestroySwapchainKHR(device, swapchain.handle, nullptr);    
+        for(Image& image : swapchain.offscreenImages)
+        {
+            DestroyImage(swapchain.allocator, image);
+        }
+        if(swapchain.depthImage.handle != VK_NULL_HANDLE)
+            DestroyImage(swapchain.allocator, swapchain.depthImage);
+        if(swapchain.colorImage.handle != VK_NULL_HANDLE)
+            DestroyImage(swapchain.allocator, swapchain.colorImage);
+        if(swapchain.handle != VK_NULL_HANDLE)
+            vkDestroySwapchainKHR(device, swapchain.handle, nullptr);    
 
         swapchain = Swapchain();
     }
@@ -648,14 +997,30 @@ namespace vkn
 
 
 
-    Buffer CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties)
+    Buffer CreateBuffer(Allocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, const std::vector<uint32_t>& queueFamilies)
     {
+        VkDevice device = allocator->GetDevice();
+
         VkBuffer buffer;
         VkBufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
         createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         createInfo.size = size;
         createInfo.usage = usage;
 
+        // shared between distinct families without ownership transfers
+        std::vector<uint32_t> families;
+        for(uint32_t family : queueFamilies)
+        {
+            if(std::find(families.begin(), families.end(), family) == families.end())
+                families.push_back(family);
+        }
+        if(families.size() > 1)
+        {
+            createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            createInfo.queueFamilyIndexCount = families.size();
+            createInfo.pQueueFamilyIndices = families.data();
+        }
+
 
         vkCreateBuffer(device, &createInfo, nullptr, &buffer);
         
@@ -663,35 +1028,28 @@ namespace vkn
         VkMemoryRequirements requirements;
         vkGetBufferMemoryRequirements(device, buffer, &requirements);
 
-        VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-        allocateInfo.allocationSize = requirements.size;
-        allocateInfo.memoryTypeIndex = vkn::GetMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, memoryProperties);
+        Allocation allocation = allocator->Allocate(requirements, memoryProperties, true);
 
-        VkDeviceMemory memory;
-        vkAllocateMemory(device, &allocateInfo, nullptr, &memory);
-
-        vkBindBufferMemory(device, buffer, memory, 0);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
 
         Buffer result;
         result.handle = buffer;
-        result.memory = memory;
+        result.allocation = allocation;
         result.memoryProperties = memoryProperties;
         result.size = requirements.size;
         result.usage = usage;
         result.bufferSize = size;
-
-        if((memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-            vkMapMemory(device, memory, 0, requirements.size, 0, &result.map);
+        result.map = allocation.map;
 
         return result;
 
     }
 
 
-    void DestroyBuffer(VkDevice device, Buffer& buffer)
+    void DestroyBuffer(Allocator* allocator, Buffer& buffer)
     {
-		vkFreeMemory(device, buffer.memory, nullptr);
-        vkDestroyBuffer(device, buffer.handle, nullptr);
+        vkDestroyBuffer(allocator->GetDevice(), buffer.handle, nullptr);
+        allocator->Free(buffer.allocation);
         buffer = Buffer();
     }
 
@@ -752,6 +1110,40 @@ namespace vkn
         vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     }
 
+    void UpdateDynamicUniformBufferDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, const Buffer& buffer, VkDeviceSize range)
+    {
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = buffer.handle;
+        bufferInfo.offset = 0;
+        bufferInfo.range = range;
+
+        VkWriteDescriptorSet descriptorWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = 0;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+
+    void UpdateStorageBufferDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, uint32_t binding, const Buffer& buffer)
+    {
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = buffer.handle;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet descriptorWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = binding;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+
     VkVertexInputAttributeDescription CreateAttributeDescription(uint32_t binding, uint32_t location, uint32_t offset, VkFormat format) 
     {
         VkVertexInputAttributeDescription attributeDescription = {};
@@ -794,20 +1186,21 @@ namespace vkn
         return poolSize;
     }
 
-    Image CreateImage(VkPhysicalDevice physicalDevice, VkDevice device, int width, int height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samplerCount) 
+    Image CreateImage(Allocator* allocator, int width, int height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samplerCount, uint32_t mipLevels, uint32_t layers, VkImageViewType viewType) 
     {
+        VkDevice device = allocator->GetDevice();
 
         Image image;
         
         VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
         imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.arrayLayers = layers;
         imageCreateInfo.extent.width = width;
         imageCreateInfo.extent.height = height;
         imageCreateInfo.extent.depth = 1;
         imageCreateInfo.format = format;;
         imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.mipLevels = mipLevels;
         imageCreateInfo.samples = samplerCount;
         imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -819,27 +1212,25 @@ namespace vkn
         VkMemoryRequirements requirements;
         vkGetImageMemoryRequirements(device, image.handle, &requirements);
 
-        VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-        allocateInfo.allocationSize = requirements.size;
-        allocateInfo.memoryTypeIndex = vkn::GetMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        vkAllocateMemory(device, &allocateInfo, nullptr, &image.memory);
+        // transient attachments never leave tile memory on tilers, so let them skip real backing where the device can
+        VkMemoryPropertyFlags preferred = usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+        image.allocation = allocator->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, preferred);
 
-        vkBindImageMemory(device, image.handle, image.memory, 0);
+        vkBindImageMemory(device, image.handle, image.allocation.memory, image.allocation.offset);
 
 
         VkImageViewCreateInfo imageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.viewType = viewType;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.format = format;
+        imageViewCreateInfo.subresourceRange.aspectMask = format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        imageViewCreateInfo.subresourceRange.levelCount = 1;
-        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
+        imageViewCreateInfo.subresourceRange.layerCount = layers;
         imageViewCreateInfo.image = image.handle;
         
         vkCreateImageView(device, &imageViewCreateInfo, nullptr, &image.imageView);
@@ -848,10 +1239,28 @@ namespace vkn
         image.format = format;
         image.width = width;
         image.height = height;
+        image.mipLevels = mipLevels;
+        image.layers = layers;
 
         return image;
     }
 
+    VkDeviceSize GetImageLevelSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        if(format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+            return GetBC1LevelSize(width, height);
+
+        return VkDeviceSize(width) * height * 4;
+    }
+
+    void DestroyImage(Allocator* allocator, Image& image)
+    {
+        vkDestroyImageView(allocator->GetDevice(), image.imageView, nullptr);
+        vkDestroyImage(allocator->GetDevice(), image.handle, nullptr);
+        allocator->Free(image.allocation);
+        image = Image();
+    }
+
     VkSampler CreateSampler(VkDevice device, VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode addressMode) 
     {
 
@@ -867,9 +1276,9 @@ namespace vkn
         samplerCreateInfo.magFilter = magFilter;
         samplerCreateInfo.minFilter = minFilter;
         samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-        samplerCreateInfo.maxLod = 1;
-        samplerCreateInfo.minLod = 1;
-        samplerCreateInfo.mipLodBias = 1;
+        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+        samplerCreateInfo.minLod = 0;
+        samplerCreateInfo.mipLodBias = 0;
         samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
 
         VkSampler sampler;
@@ -913,44 +1322,50 @@ namespace vkn
         vkQueueWaitIdle(queue);
     }
 
-    void TransitionLayout(VkDevice device, VkCommandPool commandPool, VkQueue graphicQueue, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) 
+    void TransitionLayout(BarrierBatch& barriers, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags2 srcAccessMask, VkAccessFlags2 dstAccessMask, VkPipelineStageFlags2 srcStage, VkPipelineStageFlags2 dstStage) 
     {
-        VkCommandBuffer commandBuffer = vkn::AllocateCommandBuffer(device, commandPool);
-
-        vkn::BeginSingleTimeCommandBufferRecording(commandBuffer);
-
-
-        VkImageMemoryBarrier imageMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-        imageMemoryBarrier.image = image;
-        imageMemoryBarrier.oldLayout = oldLayout;
-        imageMemoryBarrier.newLayout = newLayout;
-        imageMemoryBarrier.srcAccessMask = srcAccessMask;
-        imageMemoryBarrier.dstAccessMask = dstAccessMask;
-        imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-        imageMemoryBarrier.subresourceRange.layerCount = 1;
-        imageMemoryBarrier.subresourceRange.levelCount = 1;
-
-        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-
-        vkn::EndAndExecuteSingleTimeCommandBuffer(commandBuffer, graphicQueue);
-    
+        barriers.ImageBarrier(image, aspectMask, oldLayout, newLayout, srcStage, srcAccessMask, dstStage, dstAccessMask);
     }
 
-    VulkanContext CreateVulkanContext(GLFWwindow* window) 
+    VulkanContext CreateVulkanContext(GLFWwindow* window, VkExtent2D headlessExtent, const RenderQuality& quality) 
     {
+        PROFILE_FUNCTION();
         VulkanContext context;
+        context.headless = window == nullptr;
 
-        context.instance = vkn::CreateInstance();
+        context.instance = vkn::CreateInstance(!context.headless);
         context.physicalDevice = vkn::GetPhysicalDevice(context.instance);
-        context.surface = vkn::CreateSurface(context.instance, window);
+        if(!context.headless)
+            context.surface = vkn::CreateSurface(context.instance, window);
         context.queueIndices = vkn::GetQueueIndices(context.physicalDevice, context.surface);
-        context.device = vkn::CreateDevice(context.physicalDevice, context.queueIndices);
+        context.features = vkn::GetDeviceFeatures(context.physicalDevice);
+        context.features.swapchain = !context.headless;
+        context.device = vkn::CreateDevice(context.physicalDevice, context.queueIndices, context.features);
         context.queues = vkn::GetDeviceQueue(context.device, context.queueIndices);
-        context.renderPass = vkn::CreateRenderPass(context.device);
-        context.swapchain = vkn::CreateSwapchain(context.physicalDevice, context.device, context.surface, context.renderPass, window);
-        context.commandPool = vkn::CreateCommandPool(context.device);    
+        context.allocator = new Allocator();
+        context.allocator->Create(context.physicalDevice, context.device);
+        context.pipelineCache = vkn::LoadPipelineCache(context.physicalDevice, context.device, PIPELINE_CACHE_FILENAME);
+        context.pipelineRegistry = new PipelineRegistry();
+        context.pipelineRegistry->Create(context.device, context.pipelineCache);
+        context.quality = vkn::ClampRenderQuality(context, quality);
+        context.renderPass = vkn::GetRenderPass(context, context.quality, GetRenderPassFinalLayout(context, context.quality));
+        if(context.headless)
+            context.swapchain = vkn::CreateOffscreenSwapchain(context.allocator, context.renderPass, headlessExtent, MAX_FRAMES_IN_FLIGHT, context.quality);
+        else
+            context.swapchain = vkn::CreateSwapchain(context.physicalDevice, context.allocator, context.surface, context.renderPass, window, context.quality);
+        context.commandPool = vkn::CreateCommandPool(context.device, context.queueIndices.graphic);
+        context.commandAllocator = new CommandAllocator();
+        context.commandAllocator->Create(context.device, context.queueIndices.graphic, MAX_FRAMES_IN_FLIGHT);
+        context.descriptorHeap = new DescriptorHeap();
+        context.descriptorHeap->Create(context);
+        context.uploadManager = new UploadManager();
+        context.uploadManager->Create(context);
+        context.gpuProfiler = new GpuProfiler();
+        context.gpuProfiler->Create(context);
+        context.deletionQueue = new DeletionQueue();
+        context.deletionQueue->Create(MAX_FRAMES_IN_FLIGHT);
+        context.resourceCache = new ResourceCache();
+        context.resourceCache->Create(context);
 
         return context;
     }
@@ -0,0 +1,225 @@
+#include <Vulkan/GpuProfiler.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Profiler.hpp>
+#include <fstream>
+#include <format>
+
+namespace vkn
+{
+    static const size_t sMaxTraceEvents = 256 * 1024;
+
+    void GpuProfiler::RollingAverage::Add(double value)
+    {
+        if(count == sWindow)
+            sum -= samples[next];
+        else
+            count++;
+
+        samples[next] = value;
+        sum += value;
+        next = (next + 1) % sWindow;
+    }
+
+    void GpuProfiler::Create(const VulkanContext& context, uint32_t frameCount, uint32_t maxScopes)
+    {
+        mDevice = context.device;
+        mFrameCount = frameCount;
+        mMaxScopes = maxScopes;
+        mCurrentSlot = 0;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context.physicalDevice, &properties);
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, families.data());
+
+        uint32_t validBits = families[context.queueIndices.graphic].timestampValidBits;
+        mSupported = validBits > 0 && properties.limits.timestampPeriod > 0.f;
+        mTimestampPeriod = properties.limits.timestampPeriod;
+        mTimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        if(!mSupported)
+        {
+            std::println("gpu profiler: timestamps unsupported on the graphic queue");
+            return;
+        }
+
+        VkQueryPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = mFrameCount * mMaxScopes * 2;
+        VK_CHECK(vkCreateQueryPool(mDevice, &createInfo, nullptr, &mQueryPool));
+
+        mSlots.resize(mFrameCount);
+    }
+
+    void GpuProfiler::Destroy()
+    {
+        if(mQueryPool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+
+        mQueryPool = VK_NULL_HANDLE;
+        mSlots.clear();
+    }
+
+    void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer)
+    {
+        if(!mSupported)
+            return;
+
+        FrameSlot& slot = mSlots[mCurrentSlot];
+        if(slot.pending)
+            readBack(slot, mCurrentSlot);
+
+        vkCmdResetQueryPool(commandBuffer, mQueryPool, mCurrentSlot * mMaxScopes * 2, mMaxScopes * 2);
+
+        slot.scopes.clear();
+        slot.queryCount = 0;
+        slot.cpuBeginUs = Profiler::NowUs();
+        mScopeStack.clear();
+        mRecording = true;
+
+        BeginScope(commandBuffer, "frame");
+    }
+
+    void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer)
+    {
+        if(!mRecording)
+            return;
+
+        while(!mScopeStack.empty())
+        {
+            EndScope(commandBuffer);
+        }
+
+        mSlots[mCurrentSlot].pending = true;
+        mCurrentSlot = (mCurrentSlot + 1) % mFrameCount;
+        mRecording = false;
+    }
+
+    void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+    {
+        if(!mRecording)
+            return;
+
+        FrameSlot& slot = mSlots[mCurrentSlot];
+        if(slot.queryCount + 2 > mMaxScopes * 2)
+        {
+            mScopeStack.push_back(UINT32_MAX);
+            return;
+        }
+
+        Scope scope;
+        scope.name = name;
+        scope.depth = mScopeStack.size();
+        scope.beginQuery = slot.queryCount++;
+        scope.endQuery = slot.queryCount++;
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, mCurrentSlot * mMaxScopes * 2 + scope.beginQuery);
+
+        mScopeStack.push_back(slot.scopes.size());
+        slot.scopes.push_back(scope);
+    }
+
+    void GpuProfiler::EndScope(VkCommandBuffer commandBuffer)
+    {
+        if(!mRecording || mScopeStack.empty())
+            return;
+
+        uint32_t index = mScopeStack.back();
+        mScopeStack.pop_back();
+
+        if(index == UINT32_MAX)
+            return;
+
+        const Scope& scope = mSlots[mCurrentSlot].scopes[index];
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, mCurrentSlot * mMaxScopes * 2 + scope.endQuery);
+    }
+
+    void GpuProfiler::readBack(FrameSlot& slot, uint32_t slotIndex)
+    {
+        slot.pending = false;
+        if(slot.queryCount == 0)
+            return;
+
+        // value and availability pairs, an unavailable query just drops its scope for this frame
+        std::vector<uint64_t> data(slot.queryCount * 2);
+        vkGetQueryPoolResults(mDevice, mQueryPool, slotIndex * mMaxScopes * 2, slot.queryCount, data.size() * sizeof(uint64_t), data.data(),
+            sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        auto available = [&data](uint32_t query) { return data[query * 2 + 1] != 0; };
+        auto timestamp = [&data](uint32_t query) { return data[query * 2]; };
+
+        const Scope& frame = slot.scopes.front();
+        if(!available(frame.beginQuery))
+            return;
+
+        uint64_t origin = timestamp(frame.beginQuery);
+        double ticksToMs = mTimestampPeriod / 1000000.0;
+
+        mLastResults.clear();
+        for(const Scope& scope : slot.scopes)
+        {
+            if(!available(scope.beginQuery) || !available(scope.endQuery))
+                continue;
+
+            GpuScopeResult result;
+            result.name = scope.name;
+            result.depth = scope.depth;
+            result.startMs = ((timestamp(scope.beginQuery) - origin) & mTimestampMask) * ticksToMs;
+            result.durationMs = ((timestamp(scope.endQuery) - timestamp(scope.beginQuery)) & mTimestampMask) * ticksToMs;
+            mLastResults.push_back(result);
+
+            mAverages[scope.name].Add(result.durationMs);
+
+            if(mTraceEvents.size() < sMaxTraceEvents)
+            {
+                TraceEvent event;
+                event.name = scope.name;
+                event.startUs = slot.cpuBeginUs + result.startMs * 1000.0;
+                event.durationUs = result.durationMs * 1000.0;
+                mTraceEvents.push_back(event);
+            }
+        }
+
+        if(!mLastResults.empty() && mLastResults.front().depth == 0)
+            mLastFrameMs = mLastResults.front().durationMs;
+    }
+
+    double GpuProfiler::GetAverage(const char* name) const
+    {
+        auto it = mAverages.find(name);
+        return it != mAverages.end() ? it->second.Get() : 0.0;
+    }
+
+    void GpuProfiler::PrintAverages() const
+    {
+        for(const GpuScopeResult& result : mLastResults)
+        {
+            std::println("gpu {}{}: {:.3f} ms", std::string(result.depth * 2, ' '), result.name, GetAverage(result.name));
+        }
+    }
+
+    void GpuProfiler::ExportChromeTrace(const char* filename) const
+    {
+        std::ofstream file(filename);
+        if(!file.is_open())
+        {
+            std::println("Failed to write {}", filename);
+            return;
+        }
+
+        // timestamps share the steady clock origin with the cpu profiler so both traces line up when merged
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1000,\"args\":{\"name\":\"GPU\"}}";
+
+        for(const TraceEvent& event : mTraceEvents)
+        {
+            file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1000,\"ts\":{:.3f},\"dur\":{:.3f}}}", event.name, event.startUs, event.durationUs);
+        }
+
+        file << "\n]}\n";
+        std::println("gpu profiler: wrote {} events to {}", mTraceEvents.size(), filename);
+    }
+}
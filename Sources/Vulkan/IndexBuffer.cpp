@@ -1,49 +1,24 @@
 #include <Vulkan/IndexBuffer.hpp>
-#include <memory.h>
+#include <Vulkan/UploadManager.hpp>
 
 void vkn::IndexBuffer::Create(size_t size)
 {
-	mStagingBuffer = CreateBuffer(mContext.physicalDevice, mContext.device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	mBuffer = CreateBuffer(mContext.physicalDevice, mContext.device, size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	mBuffer = CreateBuffer(mContext.allocator, size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
 
 void vkn::IndexBuffer::Destroy()
 {
-	DestroyBuffer(mContext.device, mBuffer);
-	DestroyBuffer(mContext.device, mStagingBuffer);
+	DestroyBuffer(mContext.allocator, mBuffer);
 }
 
 void vkn::IndexBuffer::StageData(size_t size, void* data)
 {
-	memcpy(mStagingBuffer.map, data, size);
+	mStagingRegion = mContext.uploadManager->Stage(data, size);
 }
 
 void vkn::IndexBuffer::PushData()
 {
-	VkCommandBuffer transferCommandBuffer = AllocateCommandBuffer(mContext.device, mContext.commandPool);
-
-	VkCommandBufferBeginInfo transferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-	transferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(transferCommandBuffer, &transferBeginInfo);
-
-	VkBufferCopy region = {};
-	region.dstOffset = 0;
-	region.size = mStagingBuffer.size;
-	region.srcOffset = 0;
-
-	vkCmdCopyBuffer(transferCommandBuffer, mStagingBuffer.handle, mBuffer.handle, 1, &region);
-
-	vkEndCommandBuffer(transferCommandBuffer);
-
-
-	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &transferCommandBuffer;
-
-	vkQueueSubmit(mContext.queues.graphic, 1, &submitInfo, VK_NULL_HANDLE);
-
-	vkQueueWaitIdle(mContext.queues.graphic);
+	mContext.uploadManager->CopyToBuffer(mStagingRegion, mBuffer, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
 void vkn::IndexBuffer::SetData(size_t size, void* data)
@@ -0,0 +1,503 @@
+#include <Vulkan/IndirectCuller.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Vulkan/BarrierBatch.hpp>
+#include <Vulkan/DeletionQueue.hpp>
+#include <Vulkan/ResourceCache.hpp>
+#include <Vulkan/UploadManager.hpp>
+#include <Profiler.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <print>
+
+namespace vkn
+{
+    static uint32_t PreviousPowerOfTwo(uint32_t value)
+    {
+        uint32_t result = 1;
+        while(result * 2 <= value)
+            result *= 2;
+        return result;
+    }
+
+    void IndirectCuller::Create(const VulkanContext& context, const std::vector<IndirectObject>& objects, uint32_t frameCount)
+    {
+        mDevice = context.device;
+        mAllocator = context.allocator;
+        mDeletionQueue = context.deletionQueue;
+        mQueue = context.queues.compute;
+        mCompact = context.features.drawIndirectCount;
+        mMultiDraw = context.features.multiDrawIndirect;
+        mSynchronization2 = context.features.synchronization2;
+        mObjectCount = objects.size();
+
+        uint32_t computeFamily = context.queueIndices.compute;
+        uint32_t graphicFamily = context.queueIndices.graphic;
+        uint32_t transferFamily = context.queueIndices.transfer;
+
+        std::vector<VkDescriptorSetLayoutBinding> frameBindings;
+        for(uint32_t binding = 0; binding < 7; binding++)
+        {
+            frameBindings.push_back(CreateSetLayoutBinding(binding, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT));
+        }
+        frameBindings.push_back(CreateSetLayoutBinding(7, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT));
+        frameBindings.push_back(CreateSetLayoutBinding(8, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT));
+        mFrameSetLayout = CreateDescriptorSetLayout(mDevice, frameBindings);
+        mPyramidSetLayout = CreateDescriptorSetLayout(mDevice, {CreateSetLayoutBinding(0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)});
+        mReduceSetLayout = CreateDescriptorSetLayout(mDevice, {CreateSetLayoutBinding(0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT), CreateSetLayoutBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)});
+
+        mCullLayout = CreatePipelineLayout(mDevice, {mFrameSetLayout, mPyramidSetLayout}, {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t)}});
+        mReduceLayout = CreatePipelineLayout(mDevice, {mReduceSetLayout}, {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t) * 4}});
+
+        ResourceHandle cullShader = context.resourceCache->LoadShaderModule("Shaders/cull.comp.spv");
+        ResourceHandle reduceShader = context.resourceCache->LoadShaderModule("Shaders/hiz.comp.spv");
+        // a null module would only surface as a broken pipeline much later
+        if(cullShader == UINT32_MAX || reduceShader == UINT32_MAX)
+        {
+            std::println("indirect culler: Shaders/cull.comp.spv or Shaders/hiz.comp.spv is missing or invalid, build the shaders target");
+            std::abort();
+        }
+        mCullPipeline = CreateComputePipeline(mDevice, context.pipelineCache, mCullLayout, context.resourceCache->GetShaderModule(cullShader));
+        mReducePipeline = CreateComputePipeline(mDevice, context.pipelineCache, mReduceLayout, context.resourceCache->GetShaderModule(reduceShader));
+        context.resourceCache->Release(cullShader);
+        context.resourceCache->Release(reduceShader);
+
+        mOcclusionRenderPass = CreateDepthRenderPass(mDevice, VK_FORMAT_D32_SFLOAT);
+
+        // nearest with every level reachable, the pyramid already holds the farthest depth of each footprint
+        VkSamplerCreateInfo samplerCreateInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+        VK_CHECK(vkCreateSampler(mDevice, &samplerCreateInfo, nullptr, &mSampler));
+
+        mDescriptorPool = CreateDescriptorPool(mDevice, {CreatePoolSize(8 * frameCount, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER), CreatePoolSize(frameCount, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)}, frameCount);
+
+        // everything is touched by the early phase on the compute queue and the late phase or the draws on the graphics queue,
+        // that includes the object list, which the late cull reads on the graphics queue and the upload manager fills on the transfer queue
+        std::vector<uint32_t> families = {computeFamily, graphicFamily};
+        VkDeviceSize objectsSize = sizeof(IndirectObject) * std::max<size_t>(objects.size(), 1);
+        mObjects = CreateBuffer(mAllocator, objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, {computeFamily, graphicFamily, transferFamily});
+
+        VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(objects.size(), 1);
+        VkDeviceSize visibilitySize = sizeof(uint32_t) * std::max<size_t>(objects.size(), 1);
+        VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        VkBufferUsageFlags countUsage = indirectUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        mFrames.resize(frameCount);
+        for(Frame& frame : mFrames)
+        {
+            frame.earlyCommands = CreateBuffer(mAllocator, commandsSize, indirectUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families);
+            frame.earlyCount = CreateBuffer(mAllocator, sizeof(uint32_t), countUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families);
+            frame.commands = CreateBuffer(mAllocator, commandsSize, indirectUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families);
+            frame.count = CreateBuffer(mAllocator, sizeof(uint32_t), countUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families);
+            frame.visibility = CreateBuffer(mAllocator, visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families);
+            frame.stats = CreateBuffer(mAllocator, sizeof(uint32_t) * 4, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, families);
+            frame.cullData = CreateBuffer(mAllocator, sizeof(CullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostMemory, families);
+            memset(frame.stats.map, 0, sizeof(uint32_t) * 4);
+
+            frame.descriptorSet = AllocateDescriptorSet(mDevice, mDescriptorPool, {mFrameSetLayout});
+            const Buffer* storageBuffers[] = {&mObjects, &frame.earlyCommands, &frame.earlyCount, &frame.commands, &frame.count, &frame.visibility, &frame.stats};
+            for(uint32_t binding = 0; binding < 7; binding++)
+            {
+                UpdateStorageBufferDescriptorSet(mDevice, frame.descriptorSet, binding, *storageBuffers[binding]);
+            }
+
+            VkDescriptorBufferInfo bufferInfo = {frame.cullData.handle, 0, sizeof(CullData)};
+            VkWriteDescriptorSet descriptorWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrite.pBufferInfo = &bufferInfo;
+            descriptorWrite.dstSet = frame.descriptorSet;
+            descriptorWrite.dstBinding = 7;
+            vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+
+            frame.commandPool = CreateCommandPool(mDevice, computeFamily);
+            frame.commandBuffer = AllocateCommandBuffer(mDevice, frame.commandPool);
+            frame.finished = CreateSemaphore(mDevice);
+            frame.lateFinished = CreateSemaphore(mDevice);
+        }
+
+        // the early phase picks its occluders from what the previous slot's late phase left behind
+        for(uint32_t i = 0; i < frameCount; i++)
+        {
+            UpdateStorageBufferDescriptorSet(mDevice, mFrames[i].descriptorSet, 8, mFrames[(i + frameCount - 1) % frameCount].visibility);
+        }
+
+        // nothing waits here, the first Cull waits on the copy
+        mInitialized = false;
+        if(!objects.empty())
+        {
+            StagingRegion region = context.uploadManager->Stage(objects.data(), sizeof(IndirectObject) * objects.size());
+            context.uploadManager->CopyToSharedBuffer(region, mObjects, 0);
+            mObjectsUploaded = context.uploadManager->Submit();
+        }
+    }
+
+    void IndirectCuller::Destroy()
+    {
+        for(Frame& frame : mFrames)
+        {
+            DestroyBuffer(mAllocator, frame.earlyCommands);
+            DestroyBuffer(mAllocator, frame.earlyCount);
+            DestroyBuffer(mAllocator, frame.commands);
+            DestroyBuffer(mAllocator, frame.count);
+            DestroyBuffer(mAllocator, frame.visibility);
+            DestroyBuffer(mAllocator, frame.stats);
+            DestroyBuffer(mAllocator, frame.cullData);
+            vkDestroyCommandPool(mDevice, frame.commandPool, nullptr);
+            vkDestroySemaphore(mDevice, frame.finished, nullptr);
+            vkDestroySemaphore(mDevice, frame.lateFinished, nullptr);
+        }
+        mFrames.clear();
+        mPreviousFrame = UINT32_MAX;
+        mObjectsUploaded = VK_NULL_HANDLE;
+
+        destroyTargets(mDevice, mAllocator, mTargets);
+
+        DestroyBuffer(mAllocator, mObjects);
+        vkDestroySampler(mDevice, mSampler, nullptr);
+        vkDestroyRenderPass(mDevice, mOcclusionRenderPass, nullptr);
+        vkDestroyPipeline(mDevice, mCullPipeline, nullptr);
+        vkDestroyPipeline(mDevice, mReducePipeline, nullptr);
+        vkDestroyPipelineLayout(mDevice, mCullLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mReduceLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mFrameSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mPyramidSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mReduceSetLayout, nullptr);
+    }
+
+    void IndirectCuller::Resize(VkExtent2D extent)
+    {
+        if(extent.width == mTargets.extent.width && extent.height == mTargets.extent.height)
+            return;
+
+        if(mTargets.framebuffer != VK_NULL_HANDLE)
+        {
+            VkDevice device = mDevice;
+            Allocator* allocator = mAllocator;
+            mDeletionQueue->Push([device, allocator, targets = mTargets]() mutable
+            {
+                destroyTargets(device, allocator, targets);
+            });
+        }
+
+        createTargets(extent);
+    }
+
+    void IndirectCuller::createTargets(VkExtent2D extent)
+    {
+        OcclusionTargets& targets = mTargets;
+        targets = OcclusionTargets();
+        targets.extent = extent;
+
+        targets.depth = CreateImage(mAllocator, extent.width, extent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+        VkFramebufferCreateInfo framebufferCreateInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        framebufferCreateInfo.renderPass = mOcclusionRenderPass;
+        framebufferCreateInfo.attachmentCount = 1;
+        framebufferCreateInfo.pAttachments = &targets.depth.imageView;
+        framebufferCreateInfo.width = extent.width;
+        framebufferCreateInfo.height = extent.height;
+        framebufferCreateInfo.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(mDevice, &framebufferCreateInfo, nullptr, &targets.framebuffer));
+
+        // a power of two base keeps every reduction after the first an exact 2x2
+        targets.pyramidExtent = {PreviousPowerOfTwo(extent.width), PreviousPowerOfTwo(extent.height)};
+        uint32_t levelCount = 1;
+        while((std::max(targets.pyramidExtent.width, targets.pyramidExtent.height) >> levelCount) > 0)
+            levelCount++;
+
+        VkImageCreateInfo imageCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.extent = {targets.pyramidExtent.width, targets.pyramidExtent.height, 1};
+        imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageCreateInfo.mipLevels = levelCount;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VK_CHECK(vkCreateImage(mDevice, &imageCreateInfo, nullptr, &targets.pyramid));
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(mDevice, targets.pyramid, &requirements);
+        targets.pyramidAllocation = mAllocator->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+        VK_CHECK(vkBindImageMemory(mDevice, targets.pyramid, targets.pyramidAllocation.memory, targets.pyramidAllocation.offset));
+
+        VkImageViewCreateInfo imageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        imageViewCreateInfo.image = targets.pyramid;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.subresourceRange.levelCount = levelCount;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(mDevice, &imageViewCreateInfo, nullptr, &targets.pyramidView));
+
+        targets.pyramidLevels.resize(levelCount);
+        for(uint32_t level = 0; level < levelCount; level++)
+        {
+            imageViewCreateInfo.subresourceRange.baseMipLevel = level;
+            imageViewCreateInfo.subresourceRange.levelCount = 1;
+            VK_CHECK(vkCreateImageView(mDevice, &imageViewCreateInfo, nullptr, &targets.pyramidLevels[level]));
+        }
+
+        targets.descriptorPool = CreateDescriptorPool(mDevice, {CreatePoolSize(levelCount + 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER), CreatePoolSize(levelCount, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)}, levelCount + 1);
+
+        auto writeImage = [this](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout)
+        {
+            VkDescriptorImageInfo imageInfo = {type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_NULL_HANDLE : mSampler, view, layout};
+            VkWriteDescriptorSet descriptorWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.descriptorType = type;
+            descriptorWrite.pImageInfo = &imageInfo;
+            descriptorWrite.dstSet = set;
+            descriptorWrite.dstBinding = binding;
+            vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+        };
+
+        // level 0 reduces the depth attachment itself, every other level the one above it
+        targets.reduceSets.resize(levelCount);
+        for(uint32_t level = 0; level < levelCount; level++)
+        {
+            targets.reduceSets[level] = AllocateDescriptorSet(mDevice, targets.descriptorPool, {mReduceSetLayout});
+            if(level == 0)
+                writeImage(targets.reduceSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, targets.depth.imageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+            else
+                writeImage(targets.reduceSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, targets.pyramidLevels[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+            writeImage(targets.reduceSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, targets.pyramidLevels[level], VK_IMAGE_LAYOUT_GENERAL);
+        }
+
+        targets.cullSet = AllocateDescriptorSet(mDevice, targets.descriptorPool, {mPyramidSetLayout});
+        writeImage(targets.cullSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, targets.pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+    }
+
+    void IndirectCuller::destroyTargets(VkDevice device, Allocator* allocator, OcclusionTargets& targets)
+    {
+        if(targets.framebuffer == VK_NULL_HANDLE)
+            return;
+
+        vkDestroyDescriptorPool(device, targets.descriptorPool, nullptr);
+        for(VkImageView view : targets.pyramidLevels)
+        {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        vkDestroyImageView(device, targets.pyramidView, nullptr);
+        vkDestroyImage(device, targets.pyramid, nullptr);
+        allocator->Free(targets.pyramidAllocation);
+
+        vkDestroyFramebuffer(device, targets.framebuffer, nullptr);
+        DestroyImage(allocator, targets.depth);
+        targets = OcclusionTargets();
+    }
+
+    VkSemaphore IndirectCuller::Cull(uint32_t frameIndex, const CullView& view)
+    {
+        PROFILE_FUNCTION();
+        Frame& frame = mFrames[frameIndex];
+
+        // the fence of this slot was waited on, so both phases of its last frame are done and visible to the host
+        uint32_t* stats = static_cast<uint32_t*>(frame.stats.map);
+        if(frame.pending)
+        {
+            mLastStats = {mObjectCount, stats[0], stats[1], stats[2], stats[3]};
+            mTotalStats.objects += mLastStats.objects;
+            mTotalStats.occluders += mLastStats.occluders;
+            mTotalStats.frustumCulled += mLastStats.frustumCulled;
+            mTotalStats.occlusionCulled += mLastStats.occlusionCulled;
+            mTotalStats.drawn += mLastStats.drawn;
+            mResolvedFrames++;
+        }
+        memset(stats, 0, sizeof(uint32_t) * 4);
+        frame.pending = true;
+
+        CullData cullData = {};
+        cullData.view = view;
+        cullData.pyramidSize[0] = float(mTargets.pyramidExtent.width);
+        cullData.pyramidSize[1] = float(mTargets.pyramidExtent.height);
+        cullData.objectCount = mObjectCount;
+        cullData.compact = mCompact;
+        memcpy(frame.cullData.map, &cullData, sizeof(CullData));
+
+        vkResetCommandPool(mDevice, frame.commandPool, 0);
+        BeginSingleTimeCommandBufferRecording(frame.commandBuffer);
+
+        BarrierBatch barriers;
+        // everything starts visible, so the first frame draws all of it as occluders. later submits on either queue are ordered after this one
+        if(!mInitialized)
+        {
+            for(Frame& other : mFrames)
+            {
+                vkCmdFillBuffer(frame.commandBuffer, other.visibility.handle, 0, VK_WHOLE_SIZE, 1);
+                barriers.BufferBarrier(other.visibility.handle, 0, VK_WHOLE_SIZE, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            }
+        }
+        if(mCompact)
+        {
+            vkCmdFillBuffer(frame.commandBuffer, frame.earlyCount.handle, 0, sizeof(uint32_t), 0);
+            barriers.BufferBarrier(frame.earlyCount.handle, 0, sizeof(uint32_t), VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        }
+        barriers.Record(frame.commandBuffer, mSynchronization2);
+
+        uint32_t late = 0;
+        VkDescriptorSet descriptorSets[] = {frame.descriptorSet, mTargets.cullSet};
+        vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipeline);
+        vkCmdBindDescriptorSets(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullLayout, 0, 2, descriptorSets, 0, nullptr);
+        vkCmdPushConstants(frame.commandBuffer, mCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &late);
+        vkCmdDispatch(frame.commandBuffer, (mObjectCount + 63) / 64, 1, 1);
+
+        barriers.GlobalBarrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+        barriers.Record(frame.commandBuffer, mSynchronization2);
+
+        vkEndCommandBuffer(frame.commandBuffer);
+
+        // the previous frame's graphics submit signaled its late semaphore, waiting on it makes that late phase's visibility writes readable here.
+        // the finished semaphore makes the writes visible to the graphics queue, the frame fence already covers the previous reads
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStageMasks;
+        if(mPreviousFrame != UINT32_MAX)
+        {
+            waitSemaphores.push_back(mFrames[mPreviousFrame].lateFinished);
+            waitStageMasks.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        mPreviousFrame = frameIndex;
+
+        if(!mInitialized && mObjectsUploaded != VK_NULL_HANDLE)
+        {
+            waitSemaphores.push_back(mObjectsUploaded);
+            waitStageMasks.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        mInitialized = true;
+
+        ExecuteCommandBuffer(frame.commandBuffer, mQueue, waitStageMasks, VK_NULL_HANDLE, waitSemaphores, {frame.finished});
+        return frame.finished;
+    }
+
+    void IndirectCuller::BeginOcclusionPass(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        Frame& frame = mFrames[frameIndex];
+
+        if(mCompact)
+        {
+            vkCmdFillBuffer(commandBuffer, frame.count.handle, 0, sizeof(uint32_t), 0);
+
+            BarrierBatch barriers;
+            barriers.BufferBarrier(frame.count.handle, 0, sizeof(uint32_t), VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            barriers.Record(commandBuffer, mSynchronization2);
+        }
+
+        VkClearValue clearValue = {};
+        clearValue.depthStencil = {1.f, 0};
+
+        VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        renderPassBeginInfo.renderPass = mOcclusionRenderPass;
+        renderPassBeginInfo.framebuffer = mTargets.framebuffer;
+        renderPassBeginInfo.renderArea.extent = mTargets.extent;
+        renderPassBeginInfo.clearValueCount = 1;
+        renderPassBeginInfo.pClearValues = &clearValue;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport = {};
+        viewport.width = mTargets.extent.width;
+        viewport.height = mTargets.extent.height;
+        viewport.maxDepth = 1.f;
+        VkRect2D scissor = {};
+        scissor.extent = mTargets.extent;
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    void IndirectCuller::DrawOccluders(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        drawIndirect(commandBuffer, mFrames[frameIndex].earlyCommands, mFrames[frameIndex].earlyCount);
+    }
+
+    void IndirectCuller::EndOcclusionPass(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        Frame& frame = mFrames[frameIndex];
+        vkCmdEndRenderPass(commandBuffer);
+
+        // the render pass already made the depth readable, the pyramid only has to wait for the previous frame's late phase
+        BarrierBatch barriers;
+        barriers.ImageBarrier(mTargets.pyramid, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        barriers.Record(commandBuffer, mSynchronization2);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mReducePipeline);
+
+        int32_t sourceSize[2] = {int32_t(mTargets.extent.width), int32_t(mTargets.extent.height)};
+        for(uint32_t level = 0; level < mTargets.pyramidLevels.size(); level++)
+        {
+            int32_t sizes[4] = {sourceSize[0], sourceSize[1], std::max(int32_t(mTargets.pyramidExtent.width >> level), 1), std::max(int32_t(mTargets.pyramidExtent.height >> level), 1)};
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mReduceLayout, 0, 1, &mTargets.reduceSets[level], 0, nullptr);
+            vkCmdPushConstants(commandBuffer, mReduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+            vkCmdDispatch(commandBuffer, (sizes[2] + 7) / 8, (sizes[3] + 7) / 8, 1);
+
+            barriers.GlobalBarrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+            barriers.Record(commandBuffer, mSynchronization2);
+
+            sourceSize[0] = sizes[2];
+            sourceSize[1] = sizes[3];
+        }
+
+        uint32_t late = 1;
+        VkDescriptorSet descriptorSets[] = {frame.descriptorSet, mTargets.cullSet};
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullLayout, 0, 2, descriptorSets, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, mCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &late);
+        vkCmdDispatch(commandBuffer, (mObjectCount + 63) / 64, 1, 1);
+
+        barriers.GlobalBarrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_HOST_READ_BIT);
+        barriers.Record(commandBuffer, mSynchronization2);
+    }
+
+    void IndirectCuller::Draw(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        drawIndirect(commandBuffer, mFrames[frameIndex].commands, mFrames[frameIndex].count);
+    }
+
+    void IndirectCuller::drawIndirect(VkCommandBuffer commandBuffer, const Buffer& commands, const Buffer& count)
+    {
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+        if(mCompact)
+        {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, commands.handle, 0, count.handle, 0, mObjectCount, stride);
+            return;
+        }
+
+        if(mMultiDraw)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, commands.handle, 0, mObjectCount, stride);
+            return;
+        }
+
+        for(uint32_t i = 0; i < mObjectCount; i++)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, commands.handle, i * stride, 1, stride);
+        }
+    }
+
+    void IndirectCuller::PrintStats() const
+    {
+        if(mResolvedFrames == 0)
+            return;
+
+        double frames = mResolvedFrames;
+        std::println("culling: {} objects, per frame {:.1f} occluders, {:.1f} frustum culled, {:.1f} occlusion culled, {:.1f} drawn ({} frames)",
+            mObjectCount, mTotalStats.occluders / frames, mTotalStats.frustumCulled / frames, mTotalStats.occlusionCulled / frames, mTotalStats.drawn / frames, mResolvedFrames);
+    }
+}
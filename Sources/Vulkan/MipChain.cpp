@@ -0,0 +1,90 @@
+#include <Vulkan/MipChain.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vkn
+{
+    static float SrgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float LinearToSrgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    }
+
+    uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levelCount = 1;
+        while((std::max(width, height) >> levelCount) > 0)
+            levelCount++;
+        return levelCount;
+    }
+
+    MipChain BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb)
+    {
+        MipChain chain;
+        chain.width = width;
+        chain.height = height;
+
+        uint32_t levelCount = GetMipLevelCount(width, height);
+        size_t size = 0;
+        for(uint32_t level = 0; level < levelCount; level++)
+        {
+            chain.offsets.push_back(size);
+            size += size_t(chain.GetLevelWidth(level)) * chain.GetLevelHeight(level) * 4;
+        }
+
+        chain.data.resize(size);
+        memcpy(chain.data.data(), pixels, size_t(width) * height * 4);
+
+        float toLinear[256];
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            toLinear[i] = srgb ? SrgbToLinear(i / 255.f) : i / 255.f;
+        }
+
+        for(uint32_t level = 1; level < levelCount; level++)
+        {
+            const uint8_t* source = chain.data.data() + chain.offsets[level - 1];
+            uint8_t* destination = chain.data.data() + chain.offsets[level];
+            uint32_t sourceWidth = chain.GetLevelWidth(level - 1);
+            uint32_t sourceHeight = chain.GetLevelHeight(level - 1);
+            uint32_t levelWidth = chain.GetLevelWidth(level);
+            uint32_t levelHeight = chain.GetLevelHeight(level);
+
+            for(uint32_t y = 0; y < levelHeight; y++)
+            {
+                // odd sizes clamp, a 1 texel wide source just averages the texel with itself
+                uint32_t y0 = std::min(y * 2, sourceHeight - 1);
+                uint32_t y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+                for(uint32_t x = 0; x < levelWidth; x++)
+                {
+                    uint32_t x0 = std::min(x * 2, sourceWidth - 1);
+                    uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                    const uint8_t* texels[4] = {source + (y0 * sourceWidth + x0) * 4, source + (y0 * sourceWidth + x1) * 4,
+                                                source + (y1 * sourceWidth + x0) * 4, source + (y1 * sourceWidth + x1) * 4};
+
+                    uint8_t* texel = destination + (y * levelWidth + x) * 4;
+                    for(uint32_t channel = 0; channel < 3; channel++)
+                    {
+                        float sum = 0.f;
+                        for(const uint8_t* sample : texels)
+                            sum += toLinear[sample[channel]];
+
+                        float value = srgb ? LinearToSrgb(sum * 0.25f) : sum * 0.25f;
+                        texel[channel] = uint8_t(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+                    }
+
+                    // alpha is linear either way
+                    texel[3] = uint8_t((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+                }
+            }
+        }
+
+        return chain;
+    }
+}
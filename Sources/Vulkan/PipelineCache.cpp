@@ -0,0 +1,113 @@
+#include <Vulkan/PipelineCache.hpp>
+#include <Macros.hpp>
+#include <print>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+namespace vkn
+{
+    static std::vector<char> ReadCacheFile(const char* filename)
+    {
+        std::vector<char> data;
+
+        FILE* fp = fopen(filename, "rb");
+        if(fp == NULL)
+            return data;
+
+        fseek(fp, 0L, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0L, SEEK_SET);
+
+        if(size > 0)
+        {
+            data.resize(size);
+            if(fread(data.data(), size, 1, fp) != 1)
+                data.clear();
+        }
+
+        fclose(fp);
+        return data;
+    }
+
+    static bool IsCacheCompatible(VkPhysicalDevice physicalDevice, const std::vector<char>& data)
+    {
+        const size_t headerSize = 16 + VK_UUID_SIZE;
+        if(data.size() < headerSize)
+            return false;
+
+        uint32_t header[4];
+        memcpy(header, data.data(), sizeof(header));
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        return header[0] >= headerSize
+            && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && header[2] == properties.vendorID
+            && header[3] == properties.deviceID
+            && memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkPipelineCache LoadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const char* filename)
+    {
+        std::vector<char> data = ReadCacheFile(filename);
+
+        if(!data.empty() && !IsCacheCompatible(physicalDevice, data))
+        {
+            std::println("pipeline cache {} was built for another device or driver, starting cold", filename);
+            data.clear();
+        }
+
+        VkPipelineCacheCreateInfo createInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        VK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+
+        if(data.empty())
+            std::println("pipeline cache: cold start");
+        else
+            std::println("pipeline cache: warm start with {} bytes from {}", data.size(), filename);
+
+        return pipelineCache;
+    }
+
+    void SavePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const char* filename)
+    {
+        size_t size = 0;
+        VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+
+        std::vector<char> data(size);
+        VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+
+        // write next to the target and rename over it so a crash never leaves a truncated cache
+        std::string temporaryFilename = std::string(filename) + ".tmp";
+
+        FILE* fp = fopen(temporaryFilename.c_str(), "wb");
+        if(fp == NULL)
+        {
+            std::println("Failed to open file: {}", temporaryFilename);
+            return;
+        }
+
+        bool written = size == 0 || fwrite(data.data(), size, 1, fp) == 1;
+        written &= fclose(fp) == 0;
+
+        std::error_code error;
+        if(written)
+            std::filesystem::rename(temporaryFilename, filename, error);
+
+        if(!written || error)
+        {
+            std::println("Failed to write pipeline cache {}", filename);
+            std::filesystem::remove(temporaryFilename, error);
+            return;
+        }
+
+        std::println("pipeline cache: saved {} bytes to {}", size, filename);
+    }
+}
@@ -0,0 +1,241 @@
+#include <Vulkan/PipelineRegistry.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Vulkan/Hash.hpp>
+#include <Profiler.hpp>
+#include <functional>
+
+namespace vkn
+{
+    size_t GraphicsPipelineDescriptionHash::operator()(const GraphicsPipelineDescription& description) const
+    {
+        size_t seed = 0;
+        HashCombine(seed, (uint64_t)description.layout);
+        HashCombine(seed, (uint64_t)description.renderPass);
+        HashCombine(seed, (uint64_t)description.vertexShaderModule);
+        HashCombine(seed, (uint64_t)description.fragmentShaderModule);
+
+        for(const VkVertexInputBindingDescription& binding : description.vertexBindings)
+        {
+            HashCombine(seed, binding.binding);
+            HashCombine(seed, binding.stride);
+            HashCombine(seed, (uint32_t)binding.inputRate);
+        }
+
+        for(const VkVertexInputAttributeDescription& attribute : description.vertexAttributes)
+        {
+            HashCombine(seed, attribute.binding);
+            HashCombine(seed, attribute.location);
+            HashCombine(seed, attribute.offset);
+            HashCombine(seed, (uint32_t)attribute.format);
+        }
+
+        HashCombine(seed, description.blendEnable);
+        HashCombine(seed, description.depthTest);
+        HashCombine(seed, description.depthWrite);
+        HashCombine(seed, (uint32_t)description.depthCompareOp);
+        HashCombine(seed, description.cullMode);
+        HashCombine(seed, (uint32_t)description.frontFace);
+        HashCombine(seed, (uint32_t)description.samples);
+
+        return seed;
+    }
+
+    bool GraphicsPipelineDescriptionEqual::operator()(const GraphicsPipelineDescription& a, const GraphicsPipelineDescription& b) const
+    {
+        if(a.vertexBindings.size() != b.vertexBindings.size() || a.vertexAttributes.size() != b.vertexAttributes.size())
+            return false;
+
+        for(size_t i = 0; i < a.vertexBindings.size(); i++)
+        {
+            const VkVertexInputBindingDescription& x = a.vertexBindings[i];
+            const VkVertexInputBindingDescription& y = b.vertexBindings[i];
+            if(x.binding != y.binding || x.stride != y.stride || x.inputRate != y.inputRate)
+                return false;
+        }
+
+        for(size_t i = 0; i < a.vertexAttributes.size(); i++)
+        {
+            const VkVertexInputAttributeDescription& x = a.vertexAttributes[i];
+            const VkVertexInputAttributeDescription& y = b.vertexAttributes[i];
+            if(x.binding != y.binding || x.location != y.location || x.offset != y.offset || x.format != y.format)
+                return false;
+        }
+
+        return a.layout == b.layout
+            && a.renderPass == b.renderPass
+            && a.vertexShaderModule == b.vertexShaderModule
+            && a.fragmentShaderModule == b.fragmentShaderModule
+            && a.blendEnable == b.blendEnable
+            && a.depthTest == b.depthTest
+            && a.depthWrite == b.depthWrite
+            && a.depthCompareOp == b.depthCompareOp
+            && a.cullMode == b.cullMode
+            && a.frontFace == b.frontFace
+            && a.samples == b.samples;
+    }
+
+    void PipelineRegistry::Create(VkDevice device, VkPipelineCache pipelineCache, uint32_t workerCount)
+    {
+        mDevice = device;
+        mPipelineCache = pipelineCache;
+        mStopping = false;
+
+        if(workerCount == 0)
+        {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 2 ? hardwareThreads / 2 : 1;
+        }
+
+        for(uint32_t i = 0; i < workerCount; i++)
+        {
+            mWorkers.emplace_back(&PipelineRegistry::workerLoop, this);
+        }
+    }
+
+    void PipelineRegistry::Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+            mQueue.clear();
+        }
+        mQueueCondition.notify_all();
+
+        for(std::thread& worker : mWorkers)
+        {
+            worker.join();
+        }
+        mWorkers.clear();
+
+        for(Entry& entry : mEntries)
+        {
+            if(entry.pipeline != VK_NULL_HANDLE)
+                vkDestroyPipeline(mDevice, entry.pipeline, nullptr);
+        }
+
+        mEntries.clear();
+        mLookup.clear();
+    }
+
+    PipelineHandle PipelineRegistry::Request(const GraphicsPipelineDescription& description)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mStats.requests++;
+
+        auto it = mLookup.find(description);
+        if(it != mLookup.end())
+        {
+            mStats.deduplicated++;
+            return it->second;
+        }
+
+        PipelineHandle handle = mEntries.size();
+        Entry& entry = mEntries.emplace_back();
+        entry.description = description;
+
+        mLookup.emplace(description, handle);
+        mQueue.push_back(handle);
+
+        lock.unlock();
+        mQueueCondition.notify_one();
+
+        return handle;
+    }
+
+    VkPipeline PipelineRegistry::Get(PipelineHandle handle)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        Entry& entry = mEntries[handle];
+
+        // nobody picked it up yet, so compile on the calling thread instead of waiting for a worker
+        if(entry.state == State::Queued)
+        {
+            entry.state = State::Compiling;
+            mStats.compiledInline++;
+            lock.unlock();
+
+            compile(entry);
+            return entry.pipeline;
+        }
+
+        mReadyCondition.wait(lock, [&entry]() { return entry.state == State::Ready; });
+        return entry.pipeline;
+    }
+
+    VkPipeline PipelineRegistry::TryGet(PipelineHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const Entry& entry = mEntries[handle];
+        return entry.state == State::Ready ? entry.pipeline : VK_NULL_HANDLE;
+    }
+
+    void PipelineRegistry::ForgetShaderModule(VkShaderModule module)
+    {
+        std::vector<PipelineHandle> handles;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for(auto it = mLookup.begin(); it != mLookup.end();)
+            {
+                if(it->first.vertexShaderModule == module || it->first.fragmentShaderModule == module)
+                {
+                    handles.push_back(it->second);
+                    it = mLookup.erase(it);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+
+        for(PipelineHandle handle : handles)
+        {
+            Get(handle);
+        }
+    }
+
+    PipelineRegistryStats PipelineRegistry::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+    void PipelineRegistry::compile(Entry& entry)
+    {
+        VkPipeline pipeline = CreateGraphicsPipeline(mDevice, mPipelineCache, entry.description);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            entry.pipeline = pipeline;
+            entry.state = State::Ready;
+        }
+        mReadyCondition.notify_all();
+    }
+
+    void PipelineRegistry::workerLoop()
+    {
+        PROFILE_THREAD("pipeline worker");
+
+        while(true)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQueueCondition.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+
+            if(mStopping)
+                return;
+
+            PipelineHandle handle = mQueue.front();
+            mQueue.pop_front();
+
+            Entry& entry = mEntries[handle];
+            if(entry.state != State::Queued)
+                continue;
+
+            entry.state = State::Compiling;
+            mStats.compiledOnWorker++;
+            lock.unlock();
+
+            compile(entry);
+        }
+    }
+}
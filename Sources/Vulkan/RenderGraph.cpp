@@ -0,0 +1,660 @@
+#include <Vulkan/RenderGraph.hpp>
+#include <Vulkan/GpuProfiler.hpp>
+#include <Vulkan/DeletionQueue.hpp>
+#include <Vulkan/Hash.hpp>
+#include <Macros.hpp>
+#include <Profiler.hpp>
+#include <algorithm>
+#include <string>
+#include <print>
+
+namespace vkn
+{
+    static VkImageAspectFlags GetAspect(VkFormat format)
+    {
+        switch(format)
+        {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    RenderGraphResource RenderGraphBuilder::CreateTexture(const char* name, const RenderGraphTextureDescription& description)
+    {
+        RenderGraph::Resource resource;
+        resource.name = name;
+        resource.description = description;
+        resource.aspect = GetAspect(description.format);
+
+        mGraph.mResources.push_back(resource);
+        return mGraph.mResources.size() - 1;
+    }
+
+    void RenderGraphBuilder::Read(RenderGraphResource resource, const RenderGraphUsage& usage)
+    {
+        mGraph.mPasses[mPassIndex].accesses.push_back({resource, usage, usage.layout, false});
+    }
+
+    void RenderGraphBuilder::Write(RenderGraphResource resource, const RenderGraphUsage& usage, VkImageLayout layoutAfter)
+    {
+        if(layoutAfter == VK_IMAGE_LAYOUT_UNDEFINED)
+            layoutAfter = usage.layout;
+
+        mGraph.mPasses[mPassIndex].accesses.push_back({resource, usage, layoutAfter, true});
+    }
+
+    void RenderGraphBuilder::SetSideEffect()
+    {
+        mGraph.mPasses[mPassIndex].sideEffect = true;
+    }
+
+    void RenderGraph::Create(const VulkanContext& context)
+    {
+        mAllocator = context.allocator;
+        mDeletionQueue = context.deletionQueue;
+        mGpuProfiler = context.gpuProfiler;
+        mSynchronization2 = context.features.synchronization2;
+    }
+
+    void RenderGraph::Destroy()
+    {
+        VkDevice device = mAllocator->GetDevice();
+
+        for(PhysicalImage& physical : mPhysicalImages)
+        {
+            vkDestroyImageView(device, physical.imageView, nullptr);
+            vkDestroyImage(device, physical.image, nullptr);
+        }
+
+        for(MemorySlot& slot : mMemorySlots)
+        {
+            mAllocator->Free(slot.allocation);
+        }
+
+        for(Framebuffer& framebuffer : mFramebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer.handle, nullptr);
+        }
+
+        mPhysicalImages.clear();
+        mMemorySlots.clear();
+        mFramebuffers.clear();
+        mPhysicalSignature = 0;
+        Reset();
+    }
+
+    void RenderGraph::Reset()
+    {
+        mPasses.clear();
+        mResources.clear();
+        mOrder.clear();
+        mFinalBarriers.Clear();
+        mFinalBarrierCount = 0;
+    }
+
+    RenderGraphResource RenderGraph::ImportImage(const char* name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect,
+        VkImageLayout initialLayout, VkPipelineStageFlags2 initialStage, VkImageLayout finalLayout)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resource.image = image;
+        resource.imageView = imageView;
+        resource.aspect = aspect;
+        resource.initialLayout = initialLayout;
+        resource.initialStage = initialStage;
+        resource.finalLayout = finalLayout;
+
+        mResources.push_back(resource);
+        return mResources.size() - 1;
+    }
+
+    VkFramebuffer RenderGraph::GetFramebuffer(VkRenderPass renderPass, std::span<const VkImageView> attachments, VkExtent2D extent)
+    {
+        for(const Framebuffer& framebuffer : mFramebuffers)
+        {
+            if(framebuffer.renderPass == renderPass && framebuffer.extent.width == extent.width && framebuffer.extent.height == extent.height
+                && std::equal(attachments.begin(), attachments.end(), framebuffer.attachments.begin(), framebuffer.attachments.end()))
+                return framebuffer.handle;
+        }
+
+        Framebuffer& framebuffer = mFramebuffers.emplace_back();
+        framebuffer.renderPass = renderPass;
+        framebuffer.attachments.assign(attachments.begin(), attachments.end());
+        framebuffer.extent = extent;
+
+        VkFramebufferCreateInfo framebufferCreateInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        framebufferCreateInfo.renderPass = renderPass;
+        framebufferCreateInfo.attachmentCount = attachments.size();
+        framebufferCreateInfo.pAttachments = attachments.data();
+        framebufferCreateInfo.width = extent.width;
+        framebufferCreateInfo.height = extent.height;
+        framebufferCreateInfo.layers = 1;
+
+        VK_CHECK(vkCreateFramebuffer(mAllocator->GetDevice(), &framebufferCreateInfo, nullptr, &framebuffer.handle));
+        return framebuffer.handle;
+    }
+
+    void RenderGraph::ReleaseFramebuffers()
+    {
+        if(mFramebuffers.empty())
+            return;
+
+        // recorded frames may still be rendering through them
+        VkDevice device = mAllocator->GetDevice();
+        mDeletionQueue->Push([device, framebuffers = std::move(mFramebuffers)]()
+        {
+            for(const Framebuffer& framebuffer : framebuffers)
+            {
+                vkDestroyFramebuffer(device, framebuffer.handle, nullptr);
+            }
+        });
+
+        mFramebuffers.clear();
+    }
+
+    void RenderGraph::AddPass(const char* name, const std::function<void(RenderGraphBuilder&)>& setup, std::function<void(VkCommandBuffer)>&& execute)
+    {
+        Pass& pass = mPasses.emplace_back();
+        pass.name = name;
+        pass.execute = std::move(execute);
+
+        RenderGraphBuilder builder(*this, mPasses.size() - 1);
+        setup(builder);
+    }
+
+    void RenderGraph::Compile()
+    {
+        PROFILE_FUNCTION();
+
+        cullPasses();
+        sortPasses();
+        placeTransients();
+        computeBarriers();
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        // roots are passes whose results leave the graph, everything they transitively read from stays
+        std::vector<uint32_t> pending;
+        for(uint32_t i = 0; i < mPasses.size(); i++)
+        {
+            Pass& pass = mPasses[i];
+            pass.culled = true;
+
+            bool root = pass.sideEffect;
+            for(const Access& access : pass.accesses)
+            {
+                root |= access.write && mResources[access.resource].imported;
+            }
+
+            if(root)
+            {
+                pass.culled = false;
+                pending.push_back(i);
+            }
+        }
+
+        while(!pending.empty())
+        {
+            uint32_t index = pending.back();
+            pending.pop_back();
+
+            // attachments that are written are usually loaded too, so earlier writers of any touched resource are needed
+            for(const Access& access : mPasses[index].accesses)
+            {
+                for(uint32_t i = 0; i < index; i++)
+                {
+                    Pass& producer = mPasses[i];
+                    if(!producer.culled)
+                        continue;
+
+                    for(const Access& produced : producer.accesses)
+                    {
+                        if(produced.write && produced.resource == access.resource)
+                        {
+                            producer.culled = false;
+                            pending.push_back(i);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void RenderGraph::sortPasses()
+    {
+        // read after write, write after read and write after write all become edges,
+        // the sort prefers declaration order so independent passes keep the order they were added in
+        std::vector<std::vector<uint32_t>> successors(mPasses.size());
+        std::vector<uint32_t> dependencyCount(mPasses.size(), 0);
+        std::vector<uint32_t> lastWriter(mResources.size(), UINT32_MAX);
+        std::vector<std::vector<uint32_t>> readers(mResources.size());
+
+        auto addEdge = [&](uint32_t from, uint32_t to)
+        {
+            if(from == to || std::find(successors[from].begin(), successors[from].end(), to) != successors[from].end())
+                return;
+
+            successors[from].push_back(to);
+            dependencyCount[to]++;
+        };
+
+        for(uint32_t i = 0; i < mPasses.size(); i++)
+        {
+            if(mPasses[i].culled)
+                continue;
+
+            for(const Access& access : mPasses[i].accesses)
+            {
+                if(lastWriter[access.resource] != UINT32_MAX)
+                    addEdge(lastWriter[access.resource], i);
+
+                if(access.write)
+                {
+                    for(uint32_t reader : readers[access.resource])
+                    {
+                        addEdge(reader, i);
+                    }
+                    readers[access.resource].clear();
+                    lastWriter[access.resource] = i;
+                }
+                else
+                {
+                    readers[access.resource].push_back(i);
+                }
+            }
+        }
+
+        std::vector<bool> scheduled(mPasses.size(), false);
+        mOrder.clear();
+
+        while(true)
+        {
+            uint32_t next = UINT32_MAX;
+            for(uint32_t i = 0; i < mPasses.size() && next == UINT32_MAX; i++)
+            {
+                if(!mPasses[i].culled && !scheduled[i] && dependencyCount[i] == 0)
+                    next = i;
+            }
+
+            if(next == UINT32_MAX)
+                break;
+
+            scheduled[next] = true;
+            mOrder.push_back(next);
+            for(uint32_t successor : successors[next])
+            {
+                dependencyCount[successor]--;
+            }
+        }
+
+        for(uint32_t position = 0; position < mOrder.size(); position++)
+        {
+            for(const Access& access : mPasses[mOrder[position]].accesses)
+            {
+                Resource& resource = mResources[access.resource];
+                resource.firstUse = std::min(resource.firstUse, position);
+                resource.lastUse = std::max(resource.lastUse, position);
+            }
+        }
+    }
+
+    void RenderGraph::placeTransients()
+    {
+        std::vector<uint32_t> transients;
+        size_t signature = 0;
+
+        for(uint32_t i = 0; i < mResources.size(); i++)
+        {
+            const Resource& resource = mResources[i];
+            if(resource.imported || resource.firstUse == UINT32_MAX)
+                continue;
+
+            transients.push_back(i);
+            HashCombine(signature, resource.description.width);
+            HashCombine(signature, resource.description.height);
+            HashCombine(signature, (uint32_t)resource.description.format);
+            HashCombine(signature, resource.description.usage);
+            HashCombine(signature, (uint32_t)resource.description.samples);
+            HashCombine(signature, resource.firstUse);
+            HashCombine(signature, resource.lastUse);
+        }
+
+        // the same frame as last time keeps its images, anything else gets a fresh placement
+        if(signature != mPhysicalSignature || transients.size() != mPhysicalImages.size())
+        {
+            releasePhysical();
+            mPhysicalSignature = signature;
+
+            VkDevice device = mAllocator->GetDevice();
+            std::vector<VkMemoryRequirements> requirements(transients.size());
+
+            for(uint32_t i = 0; i < transients.size(); i++)
+            {
+                const Resource& resource = mResources[transients[i]];
+                PhysicalImage& physical = mPhysicalImages.emplace_back();
+                physical.description = resource.description;
+                physical.firstUse = resource.firstUse;
+                physical.lastUse = resource.lastUse;
+
+                VkImageCreateInfo imageCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+                imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageCreateInfo.extent = {resource.description.width, resource.description.height, 1};
+                imageCreateInfo.format = resource.description.format;
+                imageCreateInfo.mipLevels = 1;
+                imageCreateInfo.arrayLayers = 1;
+                imageCreateInfo.samples = resource.description.samples;
+                imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageCreateInfo.usage = resource.description.usage;
+                imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                VK_CHECK(vkCreateImage(device, &imageCreateInfo, nullptr, &physical.image));
+                vkGetImageMemoryRequirements(device, physical.image, &requirements[i]);
+                physical.size = requirements[i].size;
+            }
+
+            // largest first, each image goes into the first slot whose occupants are all dead or not yet born while it lives
+            std::vector<uint32_t> bySize(transients.size());
+            for(uint32_t i = 0; i < bySize.size(); i++)
+            {
+                bySize[i] = i;
+            }
+            std::stable_sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+            std::vector<std::vector<uint32_t>> occupants;
+            for(uint32_t i : bySize)
+            {
+                PhysicalImage& physical = mPhysicalImages[i];
+                uint32_t slotIndex = UINT32_MAX;
+
+                for(uint32_t s = 0; s < mMemorySlots.size() && slotIndex == UINT32_MAX; s++)
+                {
+                    if((mMemorySlots[s].memoryTypeBits & requirements[i].memoryTypeBits) == 0)
+                        continue;
+
+                    bool overlaps = false;
+                    for(uint32_t other : occupants[s])
+                    {
+                        const PhysicalImage& occupant = mPhysicalImages[other];
+                        overlaps |= physical.firstUse <= occupant.lastUse && occupant.firstUse <= physical.lastUse;
+                    }
+
+                    if(!overlaps)
+                        slotIndex = s;
+                }
+
+                if(slotIndex == UINT32_MAX)
+                {
+                    slotIndex = mMemorySlots.size();
+                    mMemorySlots.emplace_back();
+                    occupants.emplace_back();
+                }
+
+                MemorySlot& slot = mMemorySlots[slotIndex];
+                slot.size = std::max(slot.size, requirements[i].size);
+                slot.alignment = std::max(slot.alignment, requirements[i].alignment);
+                slot.memoryTypeBits &= requirements[i].memoryTypeBits;
+                occupants[slotIndex].push_back(i);
+                physical.slot = slotIndex;
+            }
+
+            for(uint32_t s = 0; s < mMemorySlots.size(); s++)
+            {
+                MemorySlot& slot = mMemorySlots[s];
+
+                // a slot where every occupant stays in tile memory can skip real backing, same as CreateImage does
+                bool transientOnly = true;
+                for(uint32_t i : occupants[s])
+                {
+                    transientOnly &= (mPhysicalImages[i].description.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+                }
+
+                VkMemoryRequirements slotRequirements = {slot.size, slot.alignment, slot.memoryTypeBits};
+                slot.allocation = mAllocator->Allocate(slotRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, transientOnly ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+            }
+
+            for(PhysicalImage& physical : mPhysicalImages)
+            {
+                const MemorySlot& slot = mMemorySlots[physical.slot];
+                VK_CHECK(vkBindImageMemory(device, physical.image, slot.allocation.memory, slot.allocation.offset));
+
+                VkImageViewCreateInfo imageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+                imageViewCreateInfo.image = physical.image;
+                imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                imageViewCreateInfo.format = physical.description.format;
+                imageViewCreateInfo.subresourceRange.aspectMask = GetAspect(physical.description.format);
+                imageViewCreateInfo.subresourceRange.levelCount = 1;
+                imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+                VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &physical.imageView));
+            }
+        }
+
+        for(uint32_t i = 0; i < transients.size(); i++)
+        {
+            Resource& resource = mResources[transients[i]];
+            resource.physicalIndex = i;
+            resource.image = mPhysicalImages[i].image;
+            resource.imageView = mPhysicalImages[i].imageView;
+        }
+    }
+
+    void RenderGraph::releasePhysical()
+    {
+        // every cached framebuffer may point at a view that is about to go
+        ReleaseFramebuffers();
+
+        if(mPhysicalImages.empty() && mMemorySlots.empty())
+            return;
+
+        // earlier frames may still be rendering into them
+        VkDevice device = mAllocator->GetDevice();
+        Allocator* allocator = mAllocator;
+        mDeletionQueue->Push([device, allocator, images = std::move(mPhysicalImages), slots = std::move(mMemorySlots)]() mutable
+        {
+            for(PhysicalImage& physical : images)
+            {
+                vkDestroyImageView(device, physical.imageView, nullptr);
+                vkDestroyImage(device, physical.image, nullptr);
+            }
+
+            for(MemorySlot& slot : slots)
+            {
+                allocator->Free(slot.allocation);
+            }
+        });
+
+        mPhysicalImages.clear();
+        mMemorySlots.clear();
+        mPhysicalSignature = 0;
+    }
+
+    void RenderGraph::computeBarriers()
+    {
+        std::vector<ResourceState> states(mResources.size());
+        for(uint32_t i = 0; i < mResources.size(); i++)
+        {
+            const Resource& resource = mResources[i];
+            if(resource.imported)
+            {
+                states[i].layout = resource.initialLayout;
+                states[i].stage = resource.initialStage;
+            }
+        }
+
+        // every frame shares the transients, a slot's memory is still in use by the image aliased before it in this frame or by the previous frame's last
+        // occupant. all of them run on this queue, so waiting on the stages that last touched the slot is enough
+        std::vector<ResourceState> slotStates(mMemorySlots.size());
+        for(uint32_t s = 0; s < mMemorySlots.size(); s++)
+        {
+            slotStates[s] = mMemorySlots[s].lastState;
+        }
+
+        for(uint32_t index : mOrder)
+        {
+            Pass& pass = mPasses[index];
+            pass.barriers.Clear();
+            pass.barrierCount = 0;
+
+            for(const Access& access : pass.accesses)
+            {
+                const Resource& resource = mResources[access.resource];
+                ResourceState& state = states[access.resource];
+
+                // the old contents are discarded, only the layout stays undefined
+                uint32_t slot = resource.imported ? UINT32_MAX : mPhysicalImages[resource.physicalIndex].slot;
+                if(slot != UINT32_MAX && !state.touched)
+                {
+                    state.stage = slotStates[slot].stage;
+                    state.access = slotStates[slot].access;
+                    state.written = slotStates[slot].written;
+                }
+
+                // reads in the same layout after reads only widen the stages a later write has to wait for
+                bool layoutChange = state.layout != access.usage.layout;
+                bool hazard = state.written || (access.write && state.stage != VK_PIPELINE_STAGE_2_NONE);
+
+                if(layoutChange || hazard)
+                {
+                    pass.barriers.ImageBarrier(resource.image, resource.aspect, state.layout, access.usage.layout,
+                        state.stage, state.written ? state.access : 0, access.usage.stage, access.usage.access);
+                    pass.barrierCount++;
+
+                    state.stage = access.usage.stage;
+                    state.access = access.usage.access;
+                }
+                else
+                {
+                    state.stage |= access.usage.stage;
+                    state.access |= access.usage.access;
+                }
+
+                state.layout = access.layoutAfter;
+                state.written = access.write;
+                state.touched = true;
+
+                if(slot != UINT32_MAX)
+                    slotStates[slot] = state;
+            }
+        }
+
+        for(uint32_t s = 0; s < mMemorySlots.size(); s++)
+        {
+            mMemorySlots[s].lastState = slotStates[s];
+        }
+
+        mFinalBarriers.Clear();
+        mFinalBarrierCount = 0;
+        for(uint32_t i = 0; i < mResources.size(); i++)
+        {
+            const Resource& resource = mResources[i];
+            const ResourceState& state = states[i];
+
+            if(!resource.imported || !state.touched || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout)
+                continue;
+
+            mFinalBarriers.ImageBarrier(resource.image, resource.aspect, state.layout, resource.finalLayout,
+                state.stage, state.written ? state.access : 0, VK_PIPELINE_STAGE_2_NONE, 0);
+            mFinalBarrierCount++;
+        }
+    }
+
+    void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+    {
+        PROFILE_FUNCTION();
+
+        for(uint32_t index : mOrder)
+        {
+            Pass& pass = mPasses[index];
+            pass.barriers.Record(commandBuffer, mSynchronization2);
+
+            mGpuProfiler->BeginScope(commandBuffer, pass.name);
+            pass.execute(commandBuffer);
+            mGpuProfiler->EndScope(commandBuffer);
+        }
+
+        mFinalBarriers.Record(commandBuffer, mSynchronization2);
+    }
+
+    RenderGraphStats RenderGraph::GetStats() const
+    {
+        RenderGraphStats stats;
+        stats.passCount = mPasses.size();
+        stats.culledPassCount = mPasses.size() - mOrder.size();
+        stats.barrierCount = mFinalBarrierCount;
+        stats.transientCount = mPhysicalImages.size();
+        stats.memorySlotCount = mMemorySlots.size();
+
+        for(uint32_t index : mOrder)
+        {
+            stats.barrierCount += mPasses[index].barrierCount;
+        }
+
+        for(const PhysicalImage& physical : mPhysicalImages)
+        {
+            stats.transientBytes += physical.size;
+        }
+
+        for(const MemorySlot& slot : mMemorySlots)
+        {
+            stats.allocatedBytes += slot.size;
+        }
+
+        return stats;
+    }
+
+    void RenderGraph::PrintCompiled() const
+    {
+        RenderGraphStats stats = GetStats();
+        std::println("render graph: {} passes, {} culled, {} barriers", stats.passCount, stats.culledPassCount, stats.barrierCount);
+
+        for(uint32_t position = 0; position < mOrder.size(); position++)
+        {
+            const Pass& pass = mPasses[mOrder[position]];
+            std::string reads, writes;
+            for(const Access& access : pass.accesses)
+            {
+                std::string& list = access.write ? writes : reads;
+                list += list.empty() ? "" : ", ";
+                list += mResources[access.resource].name;
+            }
+
+            std::println("  {}: {} ({} barriers) reads [{}] writes [{}]", position, pass.name, pass.barrierCount, reads, writes);
+        }
+
+        for(const Pass& pass : mPasses)
+        {
+            if(pass.culled)
+                std::println("  culled: {}", pass.name);
+        }
+
+        if(mFinalBarrierCount > 0)
+            std::println("  {} final transitions", mFinalBarrierCount);
+
+        for(uint32_t i = 0; i < mPhysicalImages.size(); i++)
+        {
+            const PhysicalImage& physical = mPhysicalImages[i];
+            const char* name = "";
+            for(const Resource& resource : mResources)
+            {
+                if(resource.physicalIndex == i)
+                    name = resource.name;
+            }
+
+            std::println("  transient {}: {}x{}, {} bytes in slot {}, alive {}..{}", name, physical.description.width, physical.description.height,
+                physical.size, physical.slot, physical.firstUse, physical.lastUse);
+        }
+
+        std::println("  transient memory: {} images in {} slots, {} bytes allocated instead of {} ({} saved)",
+            stats.transientCount, stats.memorySlotCount, stats.allocatedBytes, stats.transientBytes, stats.transientBytes - stats.allocatedBytes);
+    }
+}
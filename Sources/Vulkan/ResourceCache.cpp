@@ -0,0 +1,387 @@
+#include <Vulkan/ResourceCache.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Vulkan/DeletionQueue.hpp>
+#include <Vulkan/PipelineRegistry.hpp>
+#include <AssetArchive.hpp>
+#include <Profiler.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace vkn
+{
+    namespace
+    {
+        // different kinds never share an entry even when their bytes match
+        uint64_t contentKey(uint32_t kind, std::span<const uint8_t> data)
+        {
+            return HashAssetData(data) ^ ((kind + 1) * 0x9e3779b97f4a7c15ull);
+        }
+
+        std::string normalizePath(const char* path)
+        {
+            return std::filesystem::path(path).lexically_normal().generic_string();
+        }
+
+        bool readFile(const char* filename, std::vector<uint8_t>& data)
+        {
+            std::ifstream stream(filename, std::ios::binary);
+            if(!stream)
+                return false;
+
+            data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            return true;
+        }
+    }
+
+    void ResourceCache::Create(const VulkanContext& context)
+    {
+        mContext = context;
+    }
+
+    void ResourceCache::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        uint32_t leaked = 0;
+        for(Entry& entry : mEntries)
+        {
+            if(entry.references == 0)
+                continue;
+
+            leaked++;
+            destroyEntry(mContext.device, entry);
+        }
+
+        if(leaked > 0)
+            std::println("resource cache: {} resources still referenced at shutdown", leaked);
+
+        mEntries.clear();
+        mFreeEntries.clear();
+        mPaths.clear();
+        mContents.clear();
+    }
+
+    ResourceHandle ResourceCache::LoadTexture(const char* filename)
+    {
+        PROFILE_FUNCTION();
+        std::string path = normalizePath(filename);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.requests++;
+            ResourceHandle handle = findPath(Kind::Texture, path);
+            if(handle != UINT32_MAX)
+                return handle;
+        }
+
+        std::vector<uint8_t> data;
+        if(!readFile(filename, data))
+        {
+            std::println("Failed to load {}", filename);
+            return UINT32_MAX;
+        }
+        uint64_t key = contentKey(uint32_t(Kind::Texture), data);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        ResourceHandle handle = findContent(Kind::Texture, key, data, path);
+        if(handle != UINT32_MAX)
+            return handle;
+
+        Entry entry;
+        entry.kind = Kind::Texture;
+        entry.key = key;
+        entry.content = data;
+        entry.texture.CreateFromMemory(mContext, data.data(), data.size(), filename);
+
+        const Image& image = entry.texture.GetImage();
+        if(image.handle == VK_NULL_HANDLE)
+            return UINT32_MAX;
+
+        for(uint32_t level = 0; level < image.mipLevels; level++)
+        {
+            entry.bytes += GetImageLevelSize(image.format, std::max(image.width >> level, 1), std::max(image.height >> level, 1));
+        }
+
+        return addEntry(std::move(entry), path);
+    }
+
+    ResourceHandle ResourceCache::AddTextureArray(const char* directory, TextureArray&& textureArray)
+    {
+        std::string path = normalizePath(directory);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.requests++;
+
+        ResourceHandle handle = findPath(Kind::TextureArray, path);
+        if(handle != UINT32_MAX)
+        {
+            textureArray.Destroy();
+            return handle;
+        }
+
+        const Image& image = textureArray.GetImage();
+        if(image.handle == VK_NULL_HANDLE)
+            return UINT32_MAX;
+
+        // there are no bytes to share between directories, the path is the content
+        Entry entry;
+        entry.kind = Kind::TextureArray;
+        entry.content.assign(path.begin(), path.end());
+        entry.key = contentKey(uint32_t(Kind::TextureArray), entry.content);
+        for(uint32_t level = 0; level < image.mipLevels; level++)
+        {
+            entry.bytes += uint64_t(GetImageLevelSize(image.format, std::max(image.width >> level, 1), std::max(image.height >> level, 1))) * image.layers;
+        }
+        entry.textureArray = std::make_shared<TextureArray>(std::move(textureArray));
+
+        return addEntry(std::move(entry), path);
+    }
+
+    ResourceHandle ResourceCache::LoadShaderModule(const char* filename)
+    {
+        PROFILE_FUNCTION();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ResourceHandle handle = findPath(Kind::ShaderModule, normalizePath(filename));
+            if(handle != UINT32_MAX)
+            {
+                mStats.requests++;
+                return handle;
+            }
+        }
+
+        std::vector<uint32_t> code = ReadShaderFile(filename);
+        if(code.empty())
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.requests++;
+            return UINT32_MAX;
+        }
+
+        return LoadShaderModule(filename, code);
+    }
+
+    ResourceHandle ResourceCache::LoadShaderModule(const char* name, std::span<const uint32_t> code)
+    {
+        std::string path = normalizePath(name);
+        std::span<const uint8_t> bytes(reinterpret_cast<const uint8_t*>(code.data()), code.size_bytes());
+        uint64_t key = contentKey(uint32_t(Kind::ShaderModule), bytes);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.requests++;
+
+        ResourceHandle handle = findPath(Kind::ShaderModule, path);
+        if(handle == UINT32_MAX)
+            handle = findContent(Kind::ShaderModule, key, bytes, path);
+        if(handle != UINT32_MAX)
+            return handle;
+
+        Entry entry;
+        entry.kind = Kind::ShaderModule;
+        entry.key = key;
+        entry.content.assign(bytes.begin(), bytes.end());
+        entry.bytes = code.size_bytes();
+        entry.shaderModule = CreateShaderModule(mContext.device, code);
+        if(entry.shaderModule == VK_NULL_HANDLE)
+            return UINT32_MAX;
+
+        return addEntry(std::move(entry), path);
+    }
+
+    ResourceHandle ResourceCache::LoadSampler(VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode addressMode)
+    {
+        uint32_t parameters[] = {uint32_t(minFilter), uint32_t(magFilter), uint32_t(addressMode)};
+        std::span<const uint8_t> bytes(reinterpret_cast<const uint8_t*>(parameters), sizeof(parameters));
+        uint64_t key = contentKey(uint32_t(Kind::Sampler), bytes);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.requests++;
+
+        ResourceHandle handle = findContent(Kind::Sampler, key, bytes, std::string());
+        if(handle != UINT32_MAX)
+            return handle;
+
+        Entry entry;
+        entry.kind = Kind::Sampler;
+        entry.key = key;
+        entry.content.assign(bytes.begin(), bytes.end());
+        entry.sampler = CreateSampler(mContext.device, minFilter, magFilter, addressMode);
+        return addEntry(std::move(entry), std::string());
+    }
+
+    ResourceHandle ResourceCache::Acquire(ResourceHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle < mEntries.size() && mEntries[handle].references > 0)
+            mEntries[handle].references++;
+        return handle;
+    }
+
+    void ResourceCache::Release(ResourceHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle >= mEntries.size())
+            return;
+
+        Entry& entry = mEntries[handle];
+        if(entry.references == 0 || --entry.references > 0)
+            return;
+
+        for(const std::string& path : entry.paths)
+        {
+            mPaths.erase(path);
+        }
+        // a collision may have moved the key to another entry
+        auto content = mContents.find(entry.key);
+        if(content != mContents.end() && content->second == handle)
+            mContents.erase(content);
+        entry.content.clear();
+
+        // the registry keys pipelines on the module's handle, which the driver may hand out again
+        if(entry.shaderModule != VK_NULL_HANDLE)
+            mContext.pipelineRegistry->ForgetShaderModule(entry.shaderModule);
+
+        // frames in flight may still sample the image, shader modules and samplers just ride along
+        VkDevice device = mContext.device;
+        Entry retired = std::move(entry);
+        mContext.deletionQueue->Push([device, retired]() mutable { destroyEntry(device, retired); });
+
+        entry = Entry();
+        mFreeEntries.push_back(handle);
+        mStats.live--;
+    }
+
+    Image ResourceCache::GetImage(ResourceHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle >= mEntries.size())
+            return Image();
+
+        const Entry& entry = mEntries[handle];
+        return entry.textureArray ? entry.textureArray->GetImage() : entry.texture.GetImage();
+    }
+
+    uint32_t ResourceCache::GetTextureIndex(ResourceHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle >= mEntries.size())
+            return 0;
+
+        const Entry& entry = mEntries[handle];
+        return entry.textureArray ? entry.textureArray->GetIndex() : entry.texture.GetIndex();
+    }
+
+    VkShaderModule ResourceCache::GetShaderModule(ResourceHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle >= mEntries.size())
+            return VK_NULL_HANDLE;
+
+        return mEntries[handle].shaderModule;
+    }
+
+    VkSampler ResourceCache::GetSampler(ResourceHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(handle >= mEntries.size())
+            return VK_NULL_HANDLE;
+
+        return mEntries[handle].sampler;
+    }
+
+    ResourceCacheStats ResourceCache::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+    void ResourceCache::PrintStats() const
+    {
+        ResourceCacheStats stats = GetStats();
+        uint32_t hits = stats.pathHits + stats.contentHits;
+        double hitRate = stats.requests > 0 ? 100.0 * hits / stats.requests : 0.0;
+        std::println("resource cache: {} requests, {} by path and {} by content hash ({:.1f}% hit rate), {} created, {} KiB saved, {} still live",
+            stats.requests, stats.pathHits, stats.contentHits, hitRate, stats.created, stats.bytesSaved / 1024, stats.live);
+    }
+
+    ResourceHandle ResourceCache::findPath(Kind kind, const std::string& path)
+    {
+        auto it = mPaths.find(path);
+        if(it == mPaths.end() || mEntries[it->second].kind != kind)
+            return UINT32_MAX;
+
+        Entry& entry = mEntries[it->second];
+        entry.references++;
+        mStats.pathHits++;
+        mStats.bytesSaved += entry.bytes;
+        return it->second;
+    }
+
+    ResourceHandle ResourceCache::findContent(Kind kind, uint64_t key, std::span<const uint8_t> content, const std::string& path)
+    {
+        auto it = mContents.find(key);
+        if(it == mContents.end() || mEntries[it->second].kind != kind)
+            return UINT32_MAX;
+
+        // a 64 bit hash alone isn't enough to hand out another file's object
+        Entry& entry = mEntries[it->second];
+        if(!std::ranges::equal(entry.content, content))
+        {
+            std::println("resource cache: hash collision, {} is created separately", path.empty() ? "sampler" : path);
+            return UINT32_MAX;
+        }
+
+        // the next load under this name skips the read
+        if(!path.empty() && mPaths.emplace(path, it->second).second)
+            entry.paths.push_back(path);
+
+        entry.references++;
+        mStats.contentHits++;
+        mStats.bytesSaved += entry.bytes;
+        return it->second;
+    }
+
+    ResourceHandle ResourceCache::addEntry(Entry&& entry, const std::string& path)
+    {
+        ResourceHandle handle;
+        if(!mFreeEntries.empty())
+        {
+            handle = mFreeEntries.back();
+            mFreeEntries.pop_back();
+        }
+        else
+        {
+            handle = mEntries.size();
+            mEntries.emplace_back();
+        }
+
+        entry.references = 1;
+        if(!path.empty())
+        {
+            entry.paths.push_back(path);
+            mPaths[path] = handle;
+        }
+        mContents[entry.key] = handle;
+        mEntries[handle] = std::move(entry);
+
+        mStats.created++;
+        mStats.live++;
+        return handle;
+    }
+
+    void ResourceCache::destroyEntry(VkDevice device, Entry& entry)
+    {
+        entry.texture.Destroy();
+        if(entry.textureArray)
+            entry.textureArray->Destroy();
+        entry.textureArray.reset();
+
+        if(entry.shaderModule != VK_NULL_HANDLE)
+            vkDestroyShaderModule(device, entry.shaderModule, nullptr);
+        if(entry.sampler != VK_NULL_HANDLE)
+            vkDestroySampler(device, entry.sampler, nullptr);
+
+        entry.shaderModule = VK_NULL_HANDLE;
+        entry.sampler = VK_NULL_HANDLE;
+    }
+}
@@ -1,16 +1,19 @@
 #include "Vulkan/Functions.hpp"
 #include <Vulkan/Texture.hpp>
+#include <Vulkan/UploadManager.hpp>
+#include <Vulkan/DescriptorHeap.hpp>
+#include <Vulkan/MipChain.hpp>
 #include <memory.h>
+#include <algorithm>
 #include <stb/stb_image.h>
 
 namespace vkn
 {
-    void Texture::Create(VulkanContext context, int width, int height) 
+    void Texture::Create(VulkanContext context, int width, int height, uint32_t mipLevels) 
     {
         mContext = context;
-        mImage = CreateImage(mContext.physicalDevice, mContext.device, width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-        mSampler = CreateSampler(mContext.device);
-        mStagingBuffer = CreateBuffer(mContext.physicalDevice, mContext.device, width * height * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        mImage = CreateImage(mContext.allocator, width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, mipLevels);
+        mIndex = mContext.descriptorHeap->RegisterTexture(mImage.imageView);
     }
 
     void Texture::CreateFromFile(VulkanContext context, const char* filename) 
@@ -21,50 +24,63 @@ namespace vkn
         if(data == nullptr)
         {
             std::println("Failed to load {}", filename);
+            return;
         }
 
-        Create(context, width, height);
-        SetData(data);
+        createFromPixels(context, data, width, height);
+        stbi_image_free(data);
     }
 
-    void Texture::SetData(void* data) 
+    void Texture::CreateFromMemory(VulkanContext context, const uint8_t* data, size_t size, const char* name)
     {
-        StageData(data);
-        PushData();    
+        int width, height, channel;
+        stbi_uc* pixels = stbi_load_from_memory(data, size, &width, &height, &channel, 4);
+
+        if(pixels == nullptr)
+        {
+            std::println("Failed to load {}", name);
+            return;
+        }
+
+        createFromPixels(context, pixels, width, height);
+        stbi_image_free(pixels);
     }
 
-    void Texture::StageData(void* data) 
+    void Texture::createFromPixels(VulkanContext context, const uint8_t* pixels, int width, int height)
     {
-        memcpy(mStagingBuffer.map, data, mImage.width * mImage.height * 4);
+        MipChain mipChain = BuildMipChain(pixels, width, height);
+        Create(context, width, height, mipChain.GetLevelCount());
+        SetData(mipChain.data.data());
     }
 
-    void Texture::PushData() 
+    void Texture::Destroy()
     {
-        vkn::TransitionLayout(mContext.device, mContext.commandPool, mContext.queues.graphic, mImage.handle, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-
-        VkCommandBuffer commandBuffer = AllocateCommandBuffer(mContext.device, mContext.commandPool);
-
-        vkn::BeginSingleTimeCommandBufferRecording(commandBuffer);
+        if(mImage.handle == VK_NULL_HANDLE)
+            return;
 
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferImageHeight = 0;
-        region.bufferRowLength = 0;
-        region.imageOffset = {};
-        region.imageExtent.width = mImage.width;
-        region.imageExtent.height = mImage.height;
-        region.imageExtent.depth = 1;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageSubresource.mipLevel = 0;
+        mContext.descriptorHeap->ReleaseTexture(mIndex);
+        DestroyImage(mContext.allocator, mImage);
+    }
 
-        vkCmdCopyBufferToImage(commandBuffer, mStagingBuffer.handle, mImage.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    void Texture::SetData(void* data) 
+    {
+        StageData(data);
+        PushData();    
+    }
 
-        vkn::EndAndExecuteSingleTimeCommandBuffer(commandBuffer, mContext.queues.graphic);
+    void Texture::StageData(void* data) 
+    {
+        VkDeviceSize size = 0;
+        for(uint32_t level = 0; level < mImage.mipLevels; level++)
+        {
+            size += GetImageLevelSize(mImage.format, std::max(mImage.width >> level, 1), std::max(mImage.height >> level, 1));
+        }
 
+        mStagingRegion = mContext.uploadManager->Stage(data, size);
+    }
 
-        vkn::TransitionLayout(mContext.device, mContext.commandPool, mContext.queues.graphic, mImage.handle, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    void Texture::PushData() 
+    {
+        mContext.uploadManager->CopyToImage(mStagingRegion, mImage);
     }
 }
@@ -0,0 +1,295 @@
+#include <Vulkan/TextureArray.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Vulkan/UploadManager.hpp>
+#include <Vulkan/DescriptorHeap.hpp>
+#include <JobPool.hpp>
+#include <AssetArchive.hpp>
+#include <Profiler.hpp>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace vkn
+{
+    namespace
+    {
+        // packed bytes as they are mapped, compressed entries are expanded into storage first
+        std::span<const uint8_t> getPackedData(const AssetArchive& archive, const AssetArchiveEntry& entry, std::vector<uint8_t>& storage)
+        {
+            if(entry.compression == AssetCompression::None)
+                return archive.GetData(entry);
+
+            storage.resize(entry.size);
+            if(!archive.Read(entry, storage))
+                return {};
+            return storage;
+        }
+
+        bool readFile(const std::string& filename, std::vector<uint8_t>& data)
+        {
+            std::ifstream stream(filename, std::ios::binary);
+            if(!stream)
+                return false;
+
+            data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            return true;
+        }
+    }
+
+    void TextureArray::Load(JobPool& jobPool, const char* directory, const char* cacheDirectory, const AssetArchive* archive)
+    {
+        PROFILE_FUNCTION();
+        mDirectory = directory;
+        mCacheDirectory = cacheDirectory != nullptr ? cacheDirectory : "";
+
+        std::vector<LayerSource> sources;
+        std::vector<std::string> names;
+        std::string prefix = std::filesystem::path(directory).lexically_normal().generic_string() + "/";
+        if(archive != nullptr)
+        {
+            // the index is already sorted by name
+            for(const AssetArchiveEntry& entry : archive->GetEntries())
+            {
+                std::string_view name = archive->GetName(entry);
+                if(name.starts_with(prefix) && name.ends_with(".png"))
+                {
+                    sources.push_back({std::string(name), &entry});
+                    names.push_back(std::string(name.substr(prefix.size(), name.size() - prefix.size() - 4)));
+                }
+            }
+        }
+
+        if(!sources.empty())
+        {
+            mArchive = archive;
+        }
+        else
+        {
+            std::vector<std::filesystem::path> files;
+            std::error_code error;
+            for(const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+            {
+                if(entry.is_regular_file() && entry.path().extension() == ".png")
+                    files.push_back(entry.path());
+            }
+
+            if(error)
+                std::println("texture array: can't read {}: {}", directory, error.message());
+
+            // sorted so layer indices don't depend on the file system's order
+            std::sort(files.begin(), files.end());
+
+            for(const std::filesystem::path& file : files)
+            {
+                std::filesystem::path name = std::filesystem::relative(file, directory);
+                name.replace_extension();
+                sources.push_back({file.string(), nullptr});
+                names.push_back(name.generic_string());
+            }
+        }
+
+        // headers only, the pixels are decoded by the jobs
+        int width = 0, height = 0;
+        std::vector<std::string> layerNames;
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            int fileWidth, fileHeight, channel;
+            bool readable;
+            if(sources[i].entry != nullptr)
+            {
+                std::vector<uint8_t> storage;
+                std::span<const uint8_t> encoded = getPackedData(*archive, *sources[i].entry, storage);
+                readable = stbi_info_from_memory(encoded.data(), encoded.size(), &fileWidth, &fileHeight, &channel);
+            }
+            else
+            {
+                readable = stbi_info(sources[i].path.c_str(), &fileWidth, &fileHeight, &channel);
+            }
+
+            if(!readable)
+            {
+                std::println("texture array: can't read {}", sources[i].path);
+                continue;
+            }
+
+            if(mLayerSources.empty())
+            {
+                width = fileWidth;
+                height = fileHeight;
+            }
+            else if(fileWidth != width || fileHeight != height)
+            {
+                std::println("texture array: skipping {}, {}x{} instead of {}x{}", sources[i].path, fileWidth, fileHeight, width, height);
+                continue;
+            }
+
+            mLayers[names[i]] = mLayerSources.size();
+            mLayerSources.push_back(sources[i]);
+            layerNames.push_back(names[i]);
+        }
+
+        mWidth = width;
+        mHeight = height;
+
+        for(uint32_t layer = 0; layer < mLayerSources.size(); layer++)
+        {
+            std::string cachePath = mCacheDirectory.empty() ? std::string() : GetTextureCachePath(mCacheDirectory, layerNames[layer]);
+            LayerSource source = mLayerSources[layer];
+            mPendingLayers.push_back(jobPool.Submit([layerArchive = mArchive, source, cachePath, width, height]()
+            {
+                PROFILE_SCOPE("load texture layer");
+                double beginUs = Profiler::NowUs();
+                LayerData data = loadLayer(layerArchive, source, cachePath, width, height);
+                data.beginUs = beginUs;
+                data.endUs = Profiler::NowUs();
+                return data;
+            }));
+        }
+    }
+
+    TextureArray::LayerData TextureArray::loadLayer(const AssetArchive* archive, const LayerSource& source, const std::string& cachePath, uint32_t width, uint32_t height)
+    {
+        LayerData layer;
+        uint32_t mipLevels = GetMipLevelCount(width, height);
+
+        // a loose file is read once, for the hash and for decoding on a miss
+        std::vector<uint8_t> storage;
+        std::span<const uint8_t> encoded;
+        uint64_t sourceHash = 0;
+        if(source.entry != nullptr)
+        {
+            sourceHash = source.entry->hash;
+        }
+        else if(readFile(source.path, storage))
+        {
+            encoded = storage;
+            sourceHash = HashAssetData(encoded);
+        }
+
+        if(!cachePath.empty() && LoadTextureCache(cachePath, sourceHash, layer.compressed) &&
+            layer.compressed.width == width && layer.compressed.height == height && layer.compressed.mipLevels == mipLevels)
+        {
+            layer.fromCache = true;
+            return layer;
+        }
+
+        if(source.entry != nullptr)
+            encoded = getPackedData(*archive, *source.entry, storage);
+
+        int fileWidth, fileHeight, channel;
+        stbi_uc* data = encoded.empty() ? nullptr : stbi_load_from_memory(encoded.data(), encoded.size(), &fileWidth, &fileHeight, &channel, 4);
+
+        // the layer still has to be uploaded to leave the undefined layout, so a broken file becomes black
+        bool loaded = data != nullptr;
+        if(!loaded)
+        {
+            std::println("Failed to load {}", source.path);
+            std::vector<uint8_t> black(size_t(width) * height * 4, 0);
+            layer.mipChain = BuildMipChain(black.data(), width, height);
+        }
+        else
+        {
+            layer.mipChain = BuildMipChain(data, width, height);
+            stbi_image_free(data);
+        }
+
+        if(!cachePath.empty())
+        {
+            layer.compressed = CompressTexture(layer.mipChain);
+            if(loaded && !SaveTextureCache(cachePath, sourceHash, layer.compressed))
+                std::println("texture array: can't write {}", cachePath);
+
+            layer.mipChain = {};
+        }
+
+        return layer;
+    }
+
+    void TextureArray::Create(const VulkanContext& context)
+    {
+        PROFILE_FUNCTION();
+        mContext = context;
+
+        if(mLayerSources.empty())
+        {
+            std::println("texture array: no textures in {}", mDirectory);
+            return;
+        }
+
+        bool compressed = !mCacheDirectory.empty() && mContext.features.textureCompressionBC;
+        VkFormat format = compressed ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+
+        uint32_t mipLevels = GetMipLevelCount(mWidth, mHeight);
+        mImage = CreateImage(mContext.allocator, mWidth, mHeight, format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SAMPLE_COUNT_1_BIT, mipLevels, mLayerSources.size(), VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+        mStats = {};
+        mStats.layers = mLayerSources.size();
+        mStats.loadBeginUs = Profiler::NowUs();
+        for(uint32_t layer = 0; layer < mPendingLayers.size(); layer++)
+        {
+            LayerData data;
+            {
+                PROFILE_SCOPE("wait for texture layer");
+                data = mPendingLayers[layer].get();
+            }
+
+            mStats.loadBeginUs = std::min(mStats.loadBeginUs, data.beginUs);
+            mStats.loadEndUs = std::max(mStats.loadEndUs, data.endUs);
+            mStats.loadBusyUs += data.endUs - data.beginUs;
+
+            // the jobs only made bc1, decode again here for the rare device without it
+            if(!compressed && data.mipChain.data.empty())
+                data = loadLayer(mArchive, mLayerSources[layer], std::string(), mWidth, mHeight);
+
+            const std::vector<uint8_t>& pixels = compressed ? data.compressed.data : data.mipChain.data;
+            StagingRegion region = mContext.uploadManager->Stage(pixels.data(), pixels.size());
+            mContext.uploadManager->CopyToImage(region, mImage, layer);
+
+            if(data.fromCache)
+                mStats.cachedLayers++;
+            else
+                mStats.rebuiltLayers++;
+        }
+        mPendingLayers.clear();
+
+        mIndex = mContext.descriptorHeap->RegisterTextureArray(mImage.imageView);
+
+        std::println("texture array: {} layers of {}x{} with {} mips from {}", mLayerSources.size(), mWidth, mHeight, mipLevels, mDirectory);
+        if(compressed)
+            std::println("texture array: bc1, {} layers from the cache, {} compressed and saved to {}", mStats.cachedLayers, mStats.rebuiltLayers, mCacheDirectory);
+    }
+
+    void TextureArray::CreateFromDirectory(const VulkanContext& context, const char* directory, const char* cacheDirectory)
+    {
+        // a pool without workers runs every job as it is submitted
+        JobPool inlinePool;
+        Load(inlinePool, directory, cacheDirectory != nullptr && context.features.textureCompressionBC ? cacheDirectory : nullptr);
+        Create(context);
+    }
+
+    void TextureArray::Destroy()
+    {
+        if(mImage.handle == VK_NULL_HANDLE)
+            return;
+
+        mContext.descriptorHeap->ReleaseTextureArray(mIndex);
+        DestroyImage(mContext.allocator, mImage);
+        mLayers.clear();
+        mLayerSources.clear();
+        mArchive = nullptr;
+    }
+
+    uint32_t TextureArray::GetLayer(const std::string& name) const
+    {
+        auto it = mLayers.find(name);
+        if(it == mLayers.end())
+        {
+            std::println("texture array: no layer named {}", name);
+            return 0;
+        }
+
+        return it->second;
+    }
+}
@@ -0,0 +1,257 @@
+#include <Vulkan/TextureCache.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace vkn
+{
+    static const uint32_t sCacheMagic = 0x54314342; // "BC1T"
+    static const uint32_t sCacheVersion = 2;
+
+    struct CacheHeader
+    {
+        uint32_t magic = sCacheMagic;
+        uint32_t version = sCacheVersion;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        uint32_t padding = 0;
+        // fnv-1a of the encoded source, the same hash the asset archive stores per entry
+        uint64_t sourceHash = 0;
+        uint64_t dataSize = 0;
+    };
+
+    static uint16_t To565(const float color[3])
+    {
+        uint32_t r = uint32_t(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+        uint32_t g = uint32_t(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+        uint32_t b = uint32_t(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+        return uint16_t(r << 11 | g << 5 | b);
+    }
+
+    static void From565(uint16_t value, float color[3])
+    {
+        uint32_t r = value >> 11 & 31;
+        uint32_t g = value >> 5 & 63;
+        uint32_t b = value & 31;
+        color[0] = float(r << 3 | r >> 2);
+        color[1] = float(g << 2 | g >> 4);
+        color[2] = float(b << 3 | b >> 2);
+    }
+
+    static void CompressBlock(const float texels[16][3], uint8_t* block)
+    {
+        float mean[3] = {};
+        for(int i = 0; i < 16; i++)
+            for(int c = 0; c < 3; c++)
+                mean[c] += texels[i][c] / 16.f;
+
+        float covariance[6] = {};
+        for(int i = 0; i < 16; i++)
+        {
+            float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+            covariance[0] += d[0] * d[0];
+            covariance[1] += d[0] * d[1];
+            covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1];
+            covariance[4] += d[1] * d[2];
+            covariance[5] += d[2] * d[2];
+        }
+
+        // a few power iterations are enough to find the dominant axis of 16 colors
+        float axis[3] = {1.f, 1.f, 1.f};
+        for(int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+            float length = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+            if(length < 1e-6f)
+                break;
+            for(int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for(int i = 0; i < 16; i++)
+        {
+            float projection = 0.f;
+            for(int c = 0; c < 3; c++)
+                projection += (texels[i][c] - mean[c]) * axis[c];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float endpoint0[3], endpoint1[3];
+        for(int c = 0; c < 3; c++)
+        {
+            endpoint0[c] = mean[c] + axis[c] * maxProjection / axisLength;
+            endpoint1[c] = mean[c] + axis[c] * minProjection / axisLength;
+        }
+
+        uint16_t color0 = To565(endpoint0);
+        uint16_t color1 = To565(endpoint1);
+
+        // color0 > color1 selects the four color mode, equal endpoints just use index 0 everywhere
+        if(color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if(color0 != color1)
+        {
+            float palette[4][3];
+            From565(color0, palette[0]);
+            From565(color1, palette[1]);
+            for(int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+                palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+            }
+
+            for(int i = 0; i < 16; i++)
+            {
+                uint32_t best = 0;
+                float bestDistance = 1e30f;
+                for(uint32_t p = 0; p < 4; p++)
+                {
+                    float distance = 0.f;
+                    for(int c = 0; c < 3; c++)
+                        distance += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+                    if(distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        block[0] = color0 & 0xff;
+        block[1] = color0 >> 8;
+        block[2] = color1 & 0xff;
+        block[3] = color1 >> 8;
+        block[4] = indices & 0xff;
+        block[5] = indices >> 8 & 0xff;
+        block[6] = indices >> 16 & 0xff;
+        block[7] = indices >> 24;
+    }
+
+    uint32_t GetBC1LevelSize(uint32_t width, uint32_t height)
+    {
+        return (width + 3) / 4 * ((height + 3) / 4) * 8;
+    }
+
+    void CompressBC1(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks)
+    {
+        uint32_t blocksX = (width + 3) / 4;
+        uint32_t blocksY = (height + 3) / 4;
+
+        for(uint32_t blockY = 0; blockY < blocksY; blockY++)
+        {
+            for(uint32_t blockX = 0; blockX < blocksX; blockX++)
+            {
+                float texels[16][3];
+                for(uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+                    uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+                    const uint8_t* texel = pixels + (size_t(y) * width + x) * 4;
+                    texels[i][0] = texel[0];
+                    texels[i][1] = texel[1];
+                    texels[i][2] = texel[2];
+                }
+
+                CompressBlock(texels, blocks + (size_t(blockY) * blocksX + blockX) * 8);
+            }
+        }
+    }
+
+    CompressedTexture CompressTexture(const MipChain& mipChain)
+    {
+        CompressedTexture texture;
+        texture.width = mipChain.width;
+        texture.height = mipChain.height;
+        texture.mipLevels = mipChain.GetLevelCount();
+
+        size_t size = 0;
+        for(uint32_t level = 0; level < texture.mipLevels; level++)
+            size += GetBC1LevelSize(mipChain.GetLevelWidth(level), mipChain.GetLevelHeight(level));
+        texture.data.resize(size);
+
+        size_t offset = 0;
+        for(uint32_t level = 0; level < texture.mipLevels; level++)
+        {
+            uint32_t width = mipChain.GetLevelWidth(level);
+            uint32_t height = mipChain.GetLevelHeight(level);
+            CompressBC1(mipChain.data.data() + mipChain.offsets[level], width, height, texture.data.data() + offset);
+            offset += GetBC1LevelSize(width, height);
+        }
+
+        return texture;
+    }
+
+    std::string GetTextureCachePath(const std::string& cacheDirectory, const std::string& name)
+    {
+        return cacheDirectory + "/" + name + ".bc1";
+    }
+
+    bool LoadTextureCache(const std::string& path, uint64_t sourceHash, CompressedTexture& texture)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+            return false;
+
+        CacheHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if(!file || header.magic != sCacheMagic || header.version != sCacheVersion || header.sourceHash != sourceHash)
+            return false;
+
+        // a truncated or corrupt entry must not make the upload read past what was staged
+        if(header.width == 0 || header.height == 0 || header.mipLevels == 0 || header.mipLevels > GetMipLevelCount(header.width, header.height))
+            return false;
+
+        uint64_t expectedSize = 0;
+        for(uint32_t level = 0; level < header.mipLevels; level++)
+            expectedSize += GetBC1LevelSize(std::max(header.width >> level, 1u), std::max(header.height >> level, 1u));
+        if(header.dataSize != expectedSize)
+            return false;
+
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.mipLevels = header.mipLevels;
+        texture.data.resize(header.dataSize);
+        file.read(reinterpret_cast<char*>(texture.data.data()), header.dataSize);
+        return bool(file);
+    }
+
+    bool SaveTextureCache(const std::string& path, uint64_t sourceHash, const CompressedTexture& texture)
+    {
+        CacheHeader header;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.mipLevels = texture.mipLevels;
+        header.sourceHash = sourceHash;
+        header.dataSize = texture.data.size();
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+        // written under another name first so an interrupted save never looks like a valid entry
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+            if(!file)
+                return false;
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        return !error;
+    }
+}
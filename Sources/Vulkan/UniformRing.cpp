@@ -0,0 +1,53 @@
+#include <Vulkan/UniformRing.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Align.hpp>
+#include <cstdlib>
+
+namespace vkn
+{
+    void UniformRing::Create(Allocator* allocator, VkDeviceSize frameSize, uint32_t frameCount)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(allocator->GetPhysicalDevice(), &properties);
+
+        mAllocator = allocator;
+        mAlignment = properties.limits.minUniformBufferOffsetAlignment > 0 ? properties.limits.minUniformBufferOffsetAlignment : 1;
+        mFrameSize = AlignUp(frameSize, mAlignment);
+        mFrameCount = frameCount;
+
+        mBuffer = CreateBuffer(mAllocator, mFrameSize * mFrameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        mFrameBegin = 0;
+        mHead = 0;
+    }
+
+    void UniformRing::Destroy()
+    {
+        DestroyBuffer(mAllocator, mBuffer);
+    }
+
+    void UniformRing::BeginFrame(uint32_t frameIndex)
+    {
+        mFrameBegin = (frameIndex % mFrameCount) * mFrameSize;
+        mHead = mFrameBegin;
+    }
+
+    UniformAllocation UniformRing::Allocate(VkDeviceSize size)
+    {
+        VkDeviceSize offset = AlignUp(mHead, mAlignment);
+
+        // wrapping would overwrite uniforms that draws recorded earlier this frame still point at
+        if(offset + size > mFrameBegin + mFrameSize)
+        {
+            std::println("uniform ring out of space: {} bytes requested, {} of {} bytes per frame used", size, mHead - mFrameBegin, mFrameSize);
+            std::abort();
+        }
+
+        mHead = offset + size;
+
+        UniformAllocation allocation;
+        allocation.map = static_cast<char*>(mBuffer.map) + offset;
+        allocation.offset = static_cast<uint32_t>(offset);
+        return allocation;
+    }
+}
@@ -0,0 +1,362 @@
+#include <Vulkan/UploadManager.hpp>
+#include <Vulkan/Functions.hpp>
+#include <Macros.hpp>
+#include <Align.hpp>
+#include <Profiler.hpp>
+#include <memory.h>
+#include <algorithm>
+
+namespace vkn
+{
+    static const uint32_t sBatchCount = 4;
+
+    // the caller keeps at most this many frames in flight, so a semaphore handed out
+    // that many flushes ago has already been waited on by the graphic queue
+    static const uint64_t sSemaphoreReuseLatency = MAX_FRAMES_IN_FLIGHT + 1;
+
+    void UploadManager::Create(const VulkanContext& context, VkDeviceSize stagingSize)
+    {
+        mContext = context;
+        mCommandAllocator.Create(mContext.device, mContext.queueIndices.transfer, sBatchCount);
+        mRing = CreateBuffer(mContext.allocator, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        mBatches.resize(sBatchCount);
+        for(Batch& batch : mBatches)
+        {
+            batch.fence = CreateFence(mContext.device, VK_FALSE);
+        }
+    }
+
+    void UploadManager::Destroy()
+    {
+        WaitIdle();
+
+        for(Batch& batch : mBatches)
+        {
+            vkDestroyFence(mContext.device, batch.fence, nullptr);
+        }
+        mBatches.clear();
+
+        for(VkSemaphore semaphore : mSignaledSemaphores)
+            vkDestroySemaphore(mContext.device, semaphore, nullptr);
+        for(VkSemaphore semaphore : mFreeSemaphores)
+            vkDestroySemaphore(mContext.device, semaphore, nullptr);
+        for(auto& [semaphore, flush] : mConsumedSemaphores)
+            vkDestroySemaphore(mContext.device, semaphore, nullptr);
+
+        mSignaledSemaphores.clear();
+        mFreeSemaphores.clear();
+        mConsumedSemaphores.clear();
+
+        mCommandAllocator.Destroy();
+        DestroyBuffer(mContext.allocator, mRing);
+    }
+
+    StagingRegion UploadManager::Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+    {
+        PROFILE_FUNCTION();
+        uint64_t capacity = mRing.bufferSize;
+
+        if(size > capacity)
+        {
+            beginBatch();
+
+            Buffer buffer = CreateBuffer(mContext.allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            memcpy(buffer.map, data, size);
+            mBatches[mCurrentBatch].overflowBuffers.push_back(buffer);
+
+            StagingRegion region;
+            region.buffer = buffer.handle;
+            region.offset = 0;
+            region.size = size;
+            return region;
+        }
+
+        uint64_t head;
+        while(true)
+        {
+            if(mHead == mTail)
+            {
+                mHead = AlignUp(mHead, capacity);
+                mTail = mHead;
+            }
+
+            head = AlignUp(mHead, alignment);
+            if(head % capacity + size > capacity)
+                head = AlignUp(head, capacity);
+
+            if(head + size - mTail <= capacity)
+                break;
+
+            submit();
+            if(!mBatches[mOldestBatch].submitted)
+            {
+                mTail = mHead;
+                continue;
+            }
+            retireBatches(true);
+        }
+
+        mHead = head + size;
+        memcpy(static_cast<char*>(mRing.map) + head % capacity, data, size);
+
+        StagingRegion region;
+        region.buffer = mRing.handle;
+        region.offset = head % capacity;
+        region.size = size;
+        return region;
+    }
+
+    void UploadManager::CopyToBuffer(const StagingRegion& region, const Buffer& buffer, VkDeviceSize dstOffset, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        beginBatch();
+
+        BufferCopy bufferCopy;
+        bufferCopy.src = region.buffer;
+        bufferCopy.dst = buffer.handle;
+        bufferCopy.copy.srcOffset = region.offset;
+        bufferCopy.copy.dstOffset = dstOffset;
+        bufferCopy.copy.size = region.size;
+        mBufferCopies.push_back(bufferCopy);
+
+        if(isOwnershipTransfer())
+        {
+            uint32_t transfer = mContext.queueIndices.transfer;
+            uint32_t graphic = mContext.queueIndices.graphic;
+            mPostCopyBarriers.BufferBarrier(buffer.handle, dstOffset, region.size, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, 0, transfer, graphic);
+            mPendingAcquire.BufferBarrier(buffer.handle, dstOffset, region.size, VK_PIPELINE_STAGE_2_NONE, 0, dstStage, dstAccess, transfer, graphic);
+        }
+        else
+        {
+            mPostCopyBarriers.BufferBarrier(buffer.handle, dstOffset, region.size, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, dstStage, dstAccess);
+        }
+    }
+
+    void UploadManager::CopyToSharedBuffer(const StagingRegion& region, const Buffer& buffer, VkDeviceSize dstOffset)
+    {
+        beginBatch();
+
+        BufferCopy bufferCopy;
+        bufferCopy.src = region.buffer;
+        bufferCopy.dst = buffer.handle;
+        bufferCopy.copy.srcOffset = region.offset;
+        bufferCopy.copy.dstOffset = dstOffset;
+        bufferCopy.copy.size = region.size;
+        mBufferCopies.push_back(bufferCopy);
+    }
+
+    void UploadManager::CopyToImage(const StagingRegion& region, const Image& image, uint32_t layer)
+    {
+        beginBatch();
+
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, layer, 1};
+
+        mPreCopyBarriers.ImageBarrier(image.handle, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_2_NONE, 0, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+        // the region holds every mip level packed one after another
+        VkDeviceSize offset = region.offset;
+        for(uint32_t level = 0; level < image.mipLevels; level++)
+        {
+            uint32_t width = std::max(uint32_t(image.width) >> level, 1u);
+            uint32_t height = std::max(uint32_t(image.height) >> level, 1u);
+
+            ImageCopy imageCopy;
+            imageCopy.src = region.buffer;
+            imageCopy.dst = image.handle;
+            imageCopy.copy.bufferOffset = offset;
+            imageCopy.copy.bufferImageHeight = 0;
+            imageCopy.copy.bufferRowLength = 0;
+            imageCopy.copy.imageOffset = {};
+            imageCopy.copy.imageExtent.width = width;
+            imageCopy.copy.imageExtent.height = height;
+            imageCopy.copy.imageExtent.depth = 1;
+            imageCopy.copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageCopy.copy.imageSubresource.baseArrayLayer = layer;
+            imageCopy.copy.imageSubresource.layerCount = 1;
+            imageCopy.copy.imageSubresource.mipLevel = level;
+            mImageCopies.push_back(imageCopy);
+
+            offset += GetImageLevelSize(image.format, width, height);
+        }
+
+        if(isOwnershipTransfer())
+        {
+            uint32_t transfer = mContext.queueIndices.transfer;
+            uint32_t graphic = mContext.queueIndices.graphic;
+            mPostCopyBarriers.ImageBarrier(image.handle, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, 0, transfer, graphic);
+            mPendingAcquire.ImageBarrier(image.handle, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_2_NONE, 0, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, transfer, graphic);
+        }
+        else
+        {
+            mPostCopyBarriers.ImageBarrier(image.handle, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+        }
+    }
+
+    void UploadManager::Flush(VkCommandBuffer commandBuffer, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages)
+    {
+        PROFILE_FUNCTION();
+        submit();
+        retireBatches(false);
+
+        VkPipelineStageFlags acquireStage = static_cast<VkPipelineStageFlags>(mSubmittedAcquire.GetDstStageMask());
+        if(acquireStage == 0)
+            acquireStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        mSubmittedAcquire.Record(commandBuffer, mContext.features.synchronization2);
+
+        for(VkSemaphore semaphore : mSignaledSemaphores)
+        {
+            waitSemaphores.push_back(semaphore);
+            waitStages.push_back(acquireStage);
+            mConsumedSemaphores.push_back({semaphore, mFlushCount});
+        }
+
+        mSignaledSemaphores.clear();
+        mFlushCount++;
+
+        for(size_t i = 0; i < mConsumedSemaphores.size();)
+        {
+            if(mConsumedSemaphores[i].second + sSemaphoreReuseLatency <= mFlushCount)
+            {
+                mFreeSemaphores.push_back(mConsumedSemaphores[i].first);
+                mConsumedSemaphores.erase(mConsumedSemaphores.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    VkSemaphore UploadManager::Submit()
+    {
+        // the signal covers every write of the batch, which is all the shared copies need
+        beginBatch();
+        VkSemaphore semaphore = getSemaphore();
+        submit(semaphore);
+        mConsumedSemaphores.push_back({semaphore, mFlushCount});
+        return semaphore;
+    }
+
+    void UploadManager::WaitIdle()
+    {
+        submit();
+        while(mBatches[mOldestBatch].submitted)
+        {
+            retireBatches(true);
+        }
+    }
+
+    void UploadManager::beginBatch()
+    {
+        Batch& batch = mBatches[mCurrentBatch];
+
+        if(!mRecording)
+        {
+            while(batch.submitted)
+            {
+                retireBatches(true);
+            }
+
+            mCommandAllocator.BeginFrame(mCurrentBatch);
+            batch.commandBuffer = mCommandAllocator.Allocate();
+            BeginSingleTimeCommandBufferRecording(batch.commandBuffer);
+            mRecording = true;
+        }
+    }
+
+    VkSemaphore UploadManager::getSemaphore()
+    {
+        if(mFreeSemaphores.empty())
+            return CreateSemaphore(mContext.device);
+
+        VkSemaphore semaphore = mFreeSemaphores.back();
+        mFreeSemaphores.pop_back();
+        return semaphore;
+    }
+
+    void UploadManager::submit(VkSemaphore signalSemaphore)
+    {
+        if(!mRecording)
+            return;
+
+        Batch& batch = mBatches[mCurrentBatch];
+
+        mPreCopyBarriers.Record(batch.commandBuffer, mContext.features.synchronization2);
+
+        for(const BufferCopy& bufferCopy : mBufferCopies)
+        {
+            vkCmdCopyBuffer(batch.commandBuffer, bufferCopy.src, bufferCopy.dst, 1, &bufferCopy.copy);
+        }
+        for(const ImageCopy& imageCopy : mImageCopies)
+        {
+            vkCmdCopyBufferToImage(batch.commandBuffer, imageCopy.src, imageCopy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy.copy);
+        }
+        mBufferCopies.clear();
+        mImageCopies.clear();
+
+        mPostCopyBarriers.Record(batch.commandBuffer, mContext.features.synchronization2);
+
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+        std::vector<VkSemaphore> signalSemaphores;
+        if(isOwnershipTransfer())
+        {
+            signalSemaphores.push_back(getSemaphore());
+            mSignaledSemaphores.push_back(signalSemaphores.back());
+        }
+        if(signalSemaphore != VK_NULL_HANDLE)
+            signalSemaphores.push_back(signalSemaphore);
+        submitInfo.signalSemaphoreCount = signalSemaphores.size();
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+        VK_CHECK(vkQueueSubmit(mContext.queues.transfer, 1, &submitInfo, batch.fence));
+
+        batch.ringEnd = mHead;
+        batch.submitted = true;
+
+        mSubmittedAcquire.Append(mPendingAcquire);
+        mPendingAcquire.Clear();
+
+        mCurrentBatch = (mCurrentBatch + 1) % sBatchCount;
+        mRecording = false;
+    }
+
+    void UploadManager::retireBatches(bool wait)
+    {
+        while(mBatches[mOldestBatch].submitted)
+        {
+            Batch& batch = mBatches[mOldestBatch];
+
+            if(wait)
+            {
+                vkWaitForFences(mContext.device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+                wait = false;
+            }
+            else if(vkGetFenceStatus(mContext.device, batch.fence) != VK_SUCCESS)
+            {
+                break;
+            }
+
+            vkResetFences(mContext.device, 1, &batch.fence);
+
+            for(Buffer& buffer : batch.overflowBuffers)
+            {
+                DestroyBuffer(mContext.allocator, buffer);
+            }
+            batch.overflowBuffers.clear();
+
+            mTail = batch.ringEnd;
+            batch.submitted = false;
+            mOldestBatch = (mOldestBatch + 1) % sBatchCount;
+        }
+    }
+}
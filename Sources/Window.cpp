@@ -1,4 +1,5 @@
 #include "Window.hpp"
+#include "Profiler.hpp"
 #include <print>
 
 #define GET_USERPOINTER(window) (WindowUserPointer*)glfwGetWindowUserPointer(window)
@@ -6,6 +7,9 @@
 bool Window::sGlfwInitialized = false;
 uint32_t Window::sWindowCount = 0;
 
+// live drags report a new size every few milliseconds, only recreate once it stops changing
+static const double sResizeDebounceSeconds = 0.1;
+
 
 
 void windowCloseCallback(GLFWwindow* window)
@@ -20,6 +24,20 @@ void windowSizeCallback(GLFWwindow*  window, int width, int height)
     userPointer->input.window.size = glm::uvec2(width, height);
 }
 
+void framebufferSizeCallback(GLFWwindow* window, int width, int height)
+{
+    WindowUserPointer* userPointer = GET_USERPOINTER(window);
+    userPointer->pendingFramebufferSize = glm::uvec2(width, height);
+    userPointer->lastResizeTime = glfwGetTime();
+    userPointer->resizePending = true;
+}
+
+void windowIconifyCallback(GLFWwindow* window, int iconified)
+{
+    WindowUserPointer* userPointer = GET_USERPOINTER(window);
+    userPointer->iconified = iconified == GLFW_TRUE;
+}
+
 void cursorPosCallback(GLFWwindow* window, double x, double y)
 {
     WindowUserPointer* userPointer = GET_USERPOINTER(window);
@@ -45,6 +63,10 @@ Window::Window(int width, int height, const char* title)
 
 Window::~Window()
 {
+    // headless runs never create the window or initialize glfw
+    if(mWindow == nullptr)
+        return;
+
     glfwDestroyWindow(mWindow);
     sWindowCount--;
     if(sWindowCount == 0)
@@ -53,6 +75,8 @@ Window::~Window()
 
 const Input& Window::GetInput() const { return mUserPointer.input; }
 
+glm::uvec2 Window::GetFramebufferSize() { return mUserPointer.input.window.framebufferSize; }
+
 void Window::CreateWindow(int width, int height, const char* title)
 {
     if(!sGlfwInitialized)        
@@ -68,17 +92,43 @@ void Window::CreateWindow(int width, int height, const char* title)
     mUserPointer.input.window.size = {width, height};
     sWindowCount++;
 
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(mWindow, &framebufferWidth, &framebufferHeight);
+    mUserPointer.input.window.framebufferSize = {framebufferWidth, framebufferHeight};
+    mUserPointer.pendingFramebufferSize = mUserPointer.input.window.framebufferSize;
+
     glfwSetWindowUserPointer(mWindow, &mUserPointer);
     glfwSetWindowCloseCallback(mWindow, windowCloseCallback);
     glfwSetWindowSizeCallback(mWindow, windowSizeCallback);
+    glfwSetFramebufferSizeCallback(mWindow, framebufferSizeCallback);
+    glfwSetWindowIconifyCallback(mWindow, windowIconifyCallback);
     glfwSetCursorPosCallback(mWindow, cursorPosCallback);
     glfwSetMouseButtonCallback(mWindow, mouseButtonCallback);
 }
 
 void Window::Update()
 {
+    PROFILE_FUNCTION();
     mUserPointer.input.mouse.offset = {0,0};
     updateKeyboardInput();
+    updateWindowInput();
+}
+
+void Window::updateWindowInput()
+{
+    Input::WindowInput& input = mUserPointer.input.window;
+
+    input.resize = false;
+    if(mUserPointer.resizePending && glfwGetTime() - mUserPointer.lastResizeTime >= sResizeDebounceSeconds)
+    {
+        input.framebufferSize = mUserPointer.pendingFramebufferSize;
+        input.resize = true;
+        mUserPointer.resizePending = false;
+    }
+    input.resizing = mUserPointer.resizePending;
+
+    // some platforms only report a zero sized framebuffer and never send iconify
+    input.minimized = mUserPointer.iconified || mUserPointer.pendingFramebufferSize.x == 0 || mUserPointer.pendingFramebufferSize.y == 0;
 }
 
 void Window::updateKeyboardInput()
@@ -207,5 +257,12 @@ void Window::updateKeyboardInput()
 
 void PollEvent() 
 {
+    PROFILE_FUNCTION();
     glfwPollEvents();
 }
+
+void WaitEvent(double timeout)
+{
+    PROFILE_FUNCTION();
+    glfwWaitEventsTimeout(timeout);
+}
@@ -0,0 +1,79 @@
+#include <AssetArchive.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <print>
+
+// packs files and whole directories into one archive, names are the paths as given so the game finds them where the loose files were:
+// assetpack -c Assets.pak Shaders Textures
+int main(int argc, char** argv)
+{
+    bool compress = false;
+    int first = 1;
+    if(argc > 1 && std::string(argv[1]) == "-c")
+    {
+        compress = true;
+        first++;
+    }
+
+    if(argc - first < 2)
+    {
+        std::println("usage: assetpack [-c] <archive> <file or directory>...");
+        return 1;
+    }
+
+    std::string archivePath = argv[first];
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    for(int i = first + 1; i < argc; i++)
+    {
+        std::filesystem::path input = argv[i];
+        if(!std::filesystem::is_directory(input))
+        {
+            files.push_back(input);
+            continue;
+        }
+
+        std::error_code error;
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(input, error))
+        {
+            if(entry.is_regular_file())
+                files.push_back(entry.path());
+        }
+
+        if(error)
+        {
+            std::println("can't read {}: {}", input.string(), error.message());
+            return 1;
+        }
+    }
+
+    std::vector<AssetArchiveSource> sources;
+    uint64_t sourceBytes = 0;
+    for(const std::filesystem::path& file : files)
+    {
+        std::ifstream stream(file, std::ios::binary);
+        if(!stream)
+        {
+            std::println("can't open {}", file.string());
+            return 1;
+        }
+
+        AssetArchiveSource source;
+        source.name = file.lexically_normal().generic_string();
+        source.data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        sourceBytes += source.data.size();
+        sources.push_back(std::move(source));
+    }
+
+    if(!WriteAssetArchive(archivePath, sources, compress))
+    {
+        std::println("can't write {}", archivePath);
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::println("{} files, {} KiB -> {} ({} KiB) in {:.2f} s", sources.size(), sourceBytes / 1024, archivePath, std::filesystem::file_size(archivePath) / 1024, seconds);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <AssetArchive.hpp>
+#include <filesystem>
+#include <fstream>
+#include <print>
+
+// lists an archive, or extracts it under a directory with every entry checked against its hash:
+// assetunpack Assets.pak
+// assetunpack Assets.pak Unpacked
+int main(int argc, char** argv)
+{
+    if(argc != 2 && argc != 3)
+    {
+        std::println("usage: assetunpack <archive> [output directory]");
+        return 1;
+    }
+
+    AssetArchive archive;
+    if(!archive.Open(argv[1]))
+    {
+        std::println("can't open {}", argv[1]);
+        return 1;
+    }
+
+    uint32_t failed = 0;
+    for(const AssetArchiveEntry& entry : archive.GetEntries())
+    {
+        std::string_view name = archive.GetName(entry);
+        if(argc == 2)
+        {
+            std::println("{:>10} {:>10} {:016x} {}", entry.size, entry.storedSize, entry.hash, name);
+            continue;
+        }
+
+        std::vector<uint8_t> data(entry.size);
+        if(!archive.Read(entry, data) || HashAssetData(data) != entry.hash)
+        {
+            std::println("{} is corrupt", name);
+            failed++;
+            continue;
+        }
+
+        // names come from the archive, don't let one climb out of the output directory
+        std::filesystem::path relative = std::filesystem::path(name).lexically_normal();
+        if(relative.is_absolute() || relative.empty() || *relative.begin() == "..")
+        {
+            std::println("skipping {}, outside the output directory", name);
+            failed++;
+            continue;
+        }
+
+        std::filesystem::path path = std::filesystem::path(argv[2]) / relative;
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        std::ofstream stream(path, std::ios::binary);
+        stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if(!stream)
+        {
+            std::println("can't write {}", path.string());
+            failed++;
+        }
+    }
+
+    std::println("{} entries, {} failed", archive.GetEntries().size(), failed);
+    archive.Close();
+    return failed == 0 ? 0 : 1;
+}
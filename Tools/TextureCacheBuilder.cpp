@@ -0,0 +1,89 @@
+#include <Vulkan/TextureCache.hpp>
+#include <Vulkan/MipChain.hpp>
+#include <AssetArchive.hpp>
+#include <stb/stb_image.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <print>
+
+// offline counterpart of TextureArray's cache, compresses every png under a directory whose cache entry is missing or stale:
+// texturecache Textures/Kenney-Prototype-Textures TextureCache/Kenney-Prototype-Textures
+int main(int argc, char** argv)
+{
+    if(argc != 3)
+    {
+        std::println("usage: texturecache <source directory> <cache directory>");
+        return 1;
+    }
+
+    std::filesystem::path sourceDirectory = argv[1];
+    std::string cacheDirectory = argv[2];
+
+    uint32_t upToDate = 0, compressed = 0, failed = 0;
+    uint64_t sourceBytes = 0, cacheBytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    std::error_code error;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(sourceDirectory, error))
+    {
+        if(!entry.is_regular_file() || entry.path().extension() != ".png")
+            continue;
+
+        std::filesystem::path name = std::filesystem::relative(entry.path(), sourceDirectory);
+        name.replace_extension();
+
+        std::string sourcePath = entry.path().string();
+        std::string cachePath = vkn::GetTextureCachePath(cacheDirectory, name.generic_string());
+
+        // hashed like the packer does, so the entries also match when the game reads the png from Assets.pak
+        std::ifstream stream(sourcePath, std::ios::binary);
+        std::vector<uint8_t> encoded(std::istreambuf_iterator<char>(stream), {});
+        uint64_t sourceHash = HashAssetData(encoded);
+
+        vkn::CompressedTexture texture;
+        if(stream && vkn::LoadTextureCache(cachePath, sourceHash, texture))
+        {
+            upToDate++;
+            continue;
+        }
+
+        int width, height, channel;
+        stbi_uc* data = stream ? stbi_load_from_memory(encoded.data(), encoded.size(), &width, &height, &channel, 4) : nullptr;
+        if(data == nullptr)
+        {
+            std::println("can't load {}", sourcePath);
+            failed++;
+            continue;
+        }
+
+        vkn::MipChain mipChain = vkn::BuildMipChain(data, width, height);
+        stbi_image_free(data);
+
+        texture = vkn::CompressTexture(mipChain);
+        if(!vkn::SaveTextureCache(cachePath, sourceHash, texture))
+        {
+            std::println("can't write {}", cachePath);
+            failed++;
+            continue;
+        }
+
+        std::println("{} -> {} ({} KiB)", sourcePath, cachePath, texture.data.size() / 1024);
+        sourceBytes += mipChain.data.size();
+        cacheBytes += texture.data.size();
+        compressed++;
+    }
+
+    if(error)
+    {
+        std::println("can't read {}: {}", sourceDirectory.string(), error.message());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::println("{} compressed, {} up to date, {} failed in {:.2f} s", compressed, upToDate, failed, seconds);
+    if(compressed > 0)
+        std::println("rgba8 {} MiB -> bc1 {} MiB", sourceBytes / (1024 * 1024), cacheBytes / (1024 * 1024));
+
+    return failed > 0 ? 1 : 0;
+}
@@ -1,3 +1,5 @@
 cd Shaders
 glslc shader.vert -o shader.vert.spv
 glslc shader.frag -o shader.frag.spv
+glslc cull.comp -o cull.comp.spv
+glslc hiz.comp -o hiz.comp.spv